@@ -0,0 +1,114 @@
+#pragma once
+
+#include <algorithm>
+#include <cstring>
+#include <future>
+#include <stdexcept>
+#include <vector>
+
+struct text_range {
+    uint64_t offset;
+    uint64_t length;
+};
+
+/*
+    extracts many (offset,length) ranges at once. the ranges are split
+    into per-block pieces and sorted by block id so every block touched
+    by the batch is decoded exactly once, even if several ranges overlap
+    it. the distinct blocks are divided into contiguous chunks which are
+    decoded in parallel, each worker with its own decode context. a
+    store reading its blocks asynchronously decodes them in the order
+    the reads complete.
+    range i is written to out[i], which must hold ranges[i].length bytes.
+ */
+template <class t_idx>
+void extract_batch(const t_idx& idx, const std::vector<text_range>& ranges,
+    const std::vector<uint8_t*>& out, size_t num_threads = 1)
+{
+    struct piece {
+        uint64_t block_id;
+        size_t range_id;
+        bool operator<(const piece& p) const
+        {
+            return block_id < p.block_id;
+        }
+    };
+    const uint64_t block_size = t_idx::block_size;
+
+    if (out.size() < ranges.size()) {
+        throw std::invalid_argument("extract_batch: fewer output buffers than ranges");
+    }
+    std::vector<piece> pieces;
+    for (size_t i = 0; i < ranges.size(); i++) {
+        const auto& r = ranges[i];
+        if (r.length == 0)
+            continue;
+        if (r.offset > idx.size() || r.length > idx.size() - r.offset) {
+            throw std::out_of_range("extract_batch: range exceeds text size");
+        }
+        auto first_block = r.offset / block_size;
+        auto last_block = (r.offset + r.length - 1) / block_size;
+        for (auto b = first_block; b <= last_block; b++) {
+            pieces.push_back({ b, i });
+        }
+    }
+    if (pieces.empty())
+        return;
+    std::stable_sort(pieces.begin(), pieces.end());
+
+    // start of the pieces belonging to each distinct block
+    std::vector<size_t> block_starts;
+    for (size_t i = 0; i < pieces.size(); i++) {
+        if (i == 0 || pieces[i].block_id != pieces[i - 1].block_id)
+            block_starts.push_back(i);
+    }
+    block_starts.push_back(pieces.size());
+    size_t num_blocks = block_starts.size() - 1;
+
+    std::vector<uint64_t> block_ids(num_blocks);
+    for (size_t j = 0; j < num_blocks; j++)
+        block_ids[j] = pieces[block_starts[j]].block_id;
+
+    // let the kernel read all encoded blocks of the batch at once
+    if (num_blocks > 1) {
+        idx.prefetch_blocks(block_ids);
+    }
+
+    auto decode_blocks = [&](size_t begin, size_t end) {
+        auto ctx = idx.create_context();
+        std::vector<uint8_t> block_content(block_size);
+        std::vector<uint64_t> ids(block_ids.begin() + begin, block_ids.begin() + end);
+        // blocks may be handed over in the order their reads complete
+        idx.decode_blocks(ctx, ids, block_content, [&](size_t k, const uint8_t* content, size_t) {
+            auto j = begin + k;
+            auto block_id = block_ids[j];
+            uint64_t block_beg = block_id * block_size;
+            uint64_t block_end = block_beg + block_size;
+            for (size_t p = block_starts[j]; p < block_starts[j + 1]; p++) {
+                const auto& r = ranges[pieces[p].range_id];
+                auto beg = std::max(r.offset, block_beg);
+                auto end = std::min(r.offset + r.length, block_end);
+                std::memcpy(out[pieces[p].range_id] + (beg - r.offset),
+                    content + (beg - block_beg), end - beg);
+            }
+        });
+    };
+
+    if (num_threads <= 1 || num_blocks == 1) {
+        decode_blocks(0, num_blocks);
+        return;
+    }
+    num_threads = std::min(num_threads, num_blocks);
+    size_t blocks_per_thread = num_blocks / num_threads;
+    size_t left = num_blocks % num_threads;
+    std::vector<std::future<void> > fis;
+    size_t begin = 0;
+    for (size_t i = 0; i < num_threads; i++) {
+        size_t end = begin + blocks_per_thread + (i < left ? 1 : 0);
+        fis.push_back(std::async(std::launch::async, decode_blocks, begin, end));
+        begin = end;
+    }
+    for (auto& f : fis) {
+        f.get();
+    }
+}
@@ -10,10 +10,22 @@
 // brotli
 #include "decode.h"
 #include "encode.h"
+// FastPFor
+#include "compositecodec.h"
+#include "simdbinarypacking.h"
+#include "simdfastpfor.h"
+#include "variablebyte.h"
 
 #include "logging.hpp"
 
 #include <cassert>
+#include <cstring>
+#include <type_traits>
+
+#if defined(__SSSE3__)
+#include <tmmintrin.h>
+#endif
+
 namespace coder {
 
 struct vbyte {
@@ -97,28 +109,109 @@ struct vbyte {
             ++out_buf;
         }
     }
+    template <class t_bit_istream>
+    inline void skip(const t_bit_istream& is, size_t n) const
+    {
+        for (size_t i = 0; i < n; i++) {
+            while (is.get_int(8) & 0x80)
+                ;
+        }
+    }
 };
 
+/*
+    t_width bits per value. lists are packed and unpacked a 64-bit word
+    at a time instead of one get_int/put_int per value: the unpacker
+    works on groups of 64 values (t_width words) with compile time
+    shifts, from any bit position, so the format is plain bit packing
+    and single values can still be read with get_int.
+ */
 template <uint8_t t_width>
 struct fixed {
+private:
+    static const uint64_t mask = (t_width == 64) ? ~0ULL : ((1ULL << (t_width % 64)) - 1);
+
+    /* the value starting at bit pos of words. reads the next word only if the value spans it */
+    static inline uint64_t value_at(const uint64_t* words, uint64_t pos)
+    {
+        const uint64_t* w = words + (pos >> 6);
+        uint64_t shift = pos & 63;
+        uint64_t x = w[0] >> shift;
+        if (shift + t_width > 64)
+            x |= w[1] << (64 - shift);
+        return x & mask;
+    }
+
 public:
     static std::string type()
     {
         return "u" + std::to_string(t_width);
     }
 
+    /* the first j values of a group starting at bit 0, unrolled so every shift is a constant */
+    template <class T, size_t j>
+    static inline void unpack_group(const uint64_t* words, T* out_buf, std::integral_constant<size_t, j>)
+    {
+        unpack_group(words, out_buf, std::integral_constant<size_t, j - 1>());
+        out_buf[j - 1] = value_at(words, (j - 1) * t_width);
+    }
+    template <class T>
+    static inline void unpack_group(const uint64_t*, T*, std::integral_constant<size_t, 0>)
+    {
+    }
+
+    /* unpacks n values starting at bit offset (< 64) of words */
+    template <class T>
+    static void unpack(const uint64_t* words, uint64_t offset, T* out_buf, size_t n)
+    {
+        size_t i = 0;
+        uint64_t aligned[t_width];
+        /* while more values follow a group, the word after it exists, so a group can be realigned to bit 0 */
+        for (; i + 64 < n; i += 64) {
+            if (offset) {
+                for (size_t k = 0; k < t_width; k++)
+                    aligned[k] = (words[k] >> offset) | (words[k + 1] << (64 - offset));
+                unpack_group(aligned, out_buf + i, std::integral_constant<size_t, 64>());
+            }
+            else {
+                unpack_group(words, out_buf + i, std::integral_constant<size_t, 64>());
+            }
+            words += t_width; // 64 values fill exactly t_width words
+        }
+        for (size_t j = 0; i < n; i++, j++)
+            out_buf[i] = value_at(words, offset + j * t_width);
+    }
+
     template <class t_bit_ostream, class T>
     inline void encode(t_bit_ostream& os, T* in_buf, size_t n) const
     {
         os.expand_if_needed(t_width * n);
-        for (size_t i = 0; i < n; i++)
-            os.put_int_no_size_check(in_buf[i], t_width);
+        /* collect the values in a word and write whole words */
+        uint64_t acc = 0;
+        uint8_t filled = 0;
+        for (size_t i = 0; i < n; i++) {
+            uint64_t x = (uint64_t)in_buf[i] & mask;
+            acc |= x << filled;
+            filled += t_width;
+            if (filled >= 64) {
+                os.put_int_no_size_check(acc, 64);
+                filled -= 64;
+                acc = filled ? (x >> (t_width - filled)) : 0;
+            }
+        }
+        if (filled)
+            os.put_int_no_size_check(acc, filled);
     }
     template <class t_bit_istream, class T>
     inline void decode(const t_bit_istream& is, T* out_buf, size_t n) const
     {
-        for (size_t i = 0; i < n; i++)
-            out_buf[i] = is.get_int(t_width);
+        unpack(is.cur_data(), is.tellg() & 63, out_buf, n);
+        is.skip(t_width * n);
+    }
+    template <class t_bit_istream>
+    inline void skip(const t_bit_istream& is, size_t n) const
+    {
+        is.skip(t_width * n);
     }
 };
 
@@ -149,6 +242,185 @@ public:
         std::copy(isA, isA + n, out_buf);
         is.skip(sizeof(t_int_type) * 8 * n);
     }
+    template <class t_bit_istream>
+    inline void skip(const t_bit_istream& is, size_t n) const
+    {
+        is.align8();
+        is.skip(sizeof(t_int_type) * 8 * n);
+    }
+};
+
+/*
+    stream vbyte (lemire et al.): the byte lengths (1-4) of the values
+    are kept apart from the value bytes as 2-bit codes, four per control
+    byte. a group of four values is then decoded with one pshufb whose
+    shuffle mask is looked up by the control byte, instead of a data
+    dependent loop per value. values must fit in 32 bits. the stream is
+    byte aligned:
+
+        [ceil(n/4) control bytes][value bytes]
+ */
+struct stream_vbyte {
+private:
+    struct tables {
+        uint8_t group_length[256]; // value bytes of the four values of a control byte
+        uint8_t shuffle[256][16]; // pshufb masks spreading the value bytes over four uint32s
+        tables()
+        {
+            for (size_t c = 0; c < 256; c++) {
+                uint8_t pos = 0;
+                for (size_t i = 0; i < 4; i++) {
+                    uint8_t len = ((c >> (2 * i)) & 3) + 1;
+                    for (size_t b = 0; b < 4; b++)
+                        shuffle[c][4 * i + b] = (b < len) ? pos + b : 0xFF;
+                    pos += len;
+                }
+                group_length[c] = pos;
+            }
+        }
+    };
+
+    static const tables& lookup()
+    {
+        static const tables t;
+        return t;
+    }
+
+    static inline uint8_t byte_length(uint32_t x)
+    {
+        return (x < (1U << 8)) ? 1 : (x < (1U << 16)) ? 2 : (x < (1U << 24)) ? 3 : 4;
+    }
+
+    template <class T>
+    static inline const uint8_t* decode_one(const uint8_t* data, uint8_t code, T& out)
+    {
+        uint32_t x = 0;
+        std::memcpy(&x, data, code + 1);
+        out = x;
+        return data + code + 1;
+    }
+
+    /* bytes of the n values described by the control bytes */
+    static inline size_t data_length(const uint8_t* ctrl, size_t n)
+    {
+        const auto& t = lookup();
+        size_t len = 0;
+        size_t full = n / 4;
+        for (size_t i = 0; i < full; i++)
+            len += t.group_length[ctrl[i]];
+        for (size_t i = 0; i < n % 4; i++)
+            len += ((ctrl[full] >> (2 * i)) & 3) + 1;
+        return len;
+    }
+
+public:
+    static std::string type()
+    {
+        return "svbyte";
+    }
+
+    template <class t_bit_ostream, class T>
+    inline void encode(t_bit_ostream& os, const T* in_buf, size_t n) const
+    {
+        size_t ctrl_len = (n + 3) / 4;
+        size_t len = ctrl_len;
+        for (size_t i = 0; i < n; i++)
+            len += byte_length(in_buf[i]);
+        os.expand_if_needed(8 + 8 * len);
+        os.align8();
+        uint8_t* ctrl = (uint8_t*)os.cur_data8();
+        uint8_t* data = ctrl + ctrl_len;
+        std::fill(ctrl, data, 0);
+        for (size_t i = 0; i < n; i++) {
+            uint32_t x = in_buf[i];
+            uint8_t blen = byte_length(x);
+            ctrl[i / 4] |= (blen - 1) << (2 * (i % 4));
+            std::memcpy(data, &x, blen);
+            data += blen;
+        }
+        os.skip(8 * len);
+    }
+    template <class t_bit_istream, class T>
+    inline void decode(const t_bit_istream& is, T* out_buf, size_t n) const
+    {
+        is.align8();
+        const uint8_t* ctrl = is.cur_data8();
+        size_t ctrl_len = (n + 3) / 4;
+        const uint8_t* data = ctrl + ctrl_len;
+        const uint8_t* data_end = data + data_length(ctrl, n);
+        size_t i = 0;
+#if defined(__SSSE3__)
+        if (std::is_same<T, uint32_t>::value) {
+            /* the 16 byte loads must not leave the stream */
+            const auto& t = lookup();
+            for (; i + 4 <= n && data + 16 <= data_end; i += 4) {
+                uint8_t c = ctrl[i / 4];
+                __m128i v = _mm_loadu_si128((const __m128i*)data);
+                __m128i mask = _mm_loadu_si128((const __m128i*)t.shuffle[c]);
+                _mm_storeu_si128((__m128i*)(out_buf + i), _mm_shuffle_epi8(v, mask));
+                data += t.group_length[c];
+            }
+        }
+#endif
+        for (; i < n; i++) {
+            data = decode_one(data, (ctrl[i / 4] >> (2 * (i % 4))) & 3, out_buf[i]);
+        }
+        is.skip(8 * (data_end - ctrl));
+    }
+    template <class t_bit_istream>
+    inline void skip(const t_bit_istream& is, size_t n) const
+    {
+        is.align8();
+        size_t ctrl_len = (n + 3) / 4;
+        is.skip(8 * (ctrl_len + data_length(is.cur_data8(), n)));
+    }
+};
+
+/*
+    coders which store every value in the same number of bits
+    can skip over values without decoding them.
+ */
+template <class t_coder>
+struct fixed_width_traits {
+    static const bool random_access = false;
+};
+
+template <uint8_t t_width>
+struct fixed_width_traits<fixed<t_width> > {
+    static const bool random_access = true;
+    template <class t_bit_istream>
+    static void skip(const t_bit_istream& is, size_t n)
+    {
+        fixed<t_width>().skip(is, n);
+    }
+};
+
+template <class t_int_type>
+struct fixed_width_traits<aligned_fixed<t_int_type> > {
+    static const bool random_access = true;
+    template <class t_bit_istream>
+    static void skip(const t_bit_istream& is, size_t n)
+    {
+        aligned_fixed<t_int_type>().skip(is, n);
+    }
+};
+
+/*
+    coders which can step over values cheaply and decode a few
+    values at a time without per call setup. the fused factor
+    decoder reads literals and offsets of such coders in place.
+ */
+template <class t_coder>
+struct skippable : std::false_type {
+};
+template <>
+struct skippable<vbyte> : std::true_type {
+};
+template <uint8_t t_width>
+struct skippable<fixed<t_width> > : std::true_type {
+};
+template <class t_int_type>
+struct skippable<aligned_fixed<t_int_type> > : std::true_type {
 };
 
 template <uint8_t t_level = 6>
@@ -160,10 +432,15 @@ public:
 private:
     mutable z_stream dstrm;
     mutable z_stream istrm;
+    mutable bool dstrm_ready = false;
+    const uint8_t* m_dict = nullptr; // preset dictionary, see prime()
+    size_t m_dict_size = 0;
 
-public:
-    zlib()
+    // the deflate state is large, only allocate it when we encode
+    void init_deflate() const
     {
+        if (dstrm_ready)
+            return;
         dstrm.zalloc = Z_NULL;
         dstrm.zfree = Z_NULL;
         dstrm.opaque = Z_NULL;
@@ -173,6 +450,12 @@ public:
             window_bits,
             mem_level,
             Z_DEFAULT_STRATEGY);
+        dstrm_ready = true;
+    }
+
+public:
+    zlib()
+    {
         istrm.zalloc = Z_NULL;
         istrm.zfree = Z_NULL;
         istrm.opaque = Z_NULL;
@@ -180,7 +463,8 @@ public:
     }
     ~zlib()
     {
-        deflateEnd(&dstrm);
+        if (dstrm_ready)
+            deflateEnd(&dstrm);
         inflateEnd(&istrm);
     }
 
@@ -190,9 +474,21 @@ public:
         return "zlib-" + std::to_string(t_level);
     }
 
+    /*
+        primes every stream with a preset dictionary (deflateSetDictionary),
+        so short inputs can refer to it. the bytes are not copied and the
+        decoder has to be primed with the same ones.
+     */
+    void prime(const uint8_t* dict, size_t dict_size)
+    {
+        m_dict = dict;
+        m_dict_size = dict_size;
+    }
+
     template <class t_bit_ostream, class T>
     inline void encode(t_bit_ostream& os, const T* in_buf, size_t n) const
     {
+        init_deflate();
         uint64_t bits_required = 32 + n * 128; // upper bound
         os.expand_if_needed(bits_required);
         os.align8(); // align to bytes if needed
@@ -212,6 +508,8 @@ public:
         dstrm.next_in = (uint8_t*)in_buf;
         dstrm.next_out = out_buf;
 
+        if (m_dict_size)
+            deflateSetDictionary(&dstrm, m_dict, m_dict_size);
         auto error = deflate(&dstrm, Z_FINISH);
         deflateReset(&dstrm); // after finish we have to reset
 
@@ -267,6 +565,12 @@ public:
         istrm.next_out = (uint8_t*)out_buf;
 
         auto error = inflate(&istrm, Z_FINISH);
+        if (error == Z_NEED_DICT && m_dict_size) {
+            // a primed stream stops before the first byte until it has its dictionary
+            error = inflateSetDictionary(&istrm, m_dict, m_dict_size);
+            if (error == Z_OK)
+                error = inflate(&istrm, Z_FINISH);
+        }
         inflateReset(&istrm); // after finish we need to reset
         if (error != Z_STREAM_END) {
             switch (error) {
@@ -303,8 +607,6 @@ private:
 public:
     lz4hc()
     {
-        auto state_size = LZ4_sizeofStateHC();
-        lz4_state = malloc(state_size);
     }
     ~lz4hc()
     {
@@ -320,6 +622,8 @@ public:
     template <class t_bit_ostream, class T>
     inline void encode(t_bit_ostream& os, const T* in_buf, size_t n) const
     {
+        if (lz4_state == nullptr) // only needed for encoding
+            lz4_state = malloc(LZ4_sizeofStateHC());
         uint64_t bits_required = 32 + n * 128; // upper bound
         os.expand_if_needed(bits_required);
         os.align8(); // align to bytes if needed
@@ -620,4 +924,109 @@ public:
 };
 
 
+
+/*
+    integer codecs of the FastPFor library. they work on 32-bit words
+    at a byte aligned stream position, like aligned_fixed. the simd
+    codecs need 16 byte aligned input and output, which a position in
+    the factor stream usually is not, so the words are staged through
+    aligned scratch owned by the coder (one per decode context). the
+    tail of a list that does not fill a 128 value block is stored with
+    variable byte coding.
+
+        [uint32 number of words][words]
+ */
+template <class t_codec>
+struct fastpfor_codec {
+private:
+    static const size_t block_values = 128;
+    mutable t_codec codec;
+    mutable std::vector<uint32_t> in_scratch;
+    mutable std::vector<uint32_t> out_scratch;
+
+    /* a 16 byte aligned buffer of at least n words */
+    static uint32_t* aligned(std::vector<uint32_t>& buf, size_t n)
+    {
+        if (buf.size() < n + 4)
+            buf.resize(n + 4);
+        auto ptr = (uintptr_t)buf.data();
+        return (uint32_t*)((ptr + 15) & ~uintptr_t(15));
+    }
+
+public:
+    template <class t_bit_ostream, class T>
+    inline void encode(t_bit_ostream& os, const T* in_buf, size_t n) const
+    {
+        static_assert(sizeof(T) <= sizeof(uint32_t), "fastpfor codecs encode 32-bit integers");
+        uint32_t* in = aligned(in_scratch, n);
+        std::copy(in_buf, in_buf + n, in);
+        size_t out_words = n + 2 * block_values + 1024; // room for incompressible input
+        uint32_t* out = aligned(out_scratch, out_words);
+        if (n)
+            codec.encodeArray(in, n, out, out_words);
+        else
+            out_words = 0;
+
+        os.expand_if_needed(8 + 32 + 32 * out_words);
+        os.align8();
+        uint32_t words = out_words;
+        std::memcpy(os.cur_data8(), &words, sizeof(words));
+        os.skip(32);
+        std::memcpy(os.cur_data8(), out, out_words * sizeof(uint32_t));
+        os.skip(32 * out_words);
+    }
+
+    template <class t_bit_istream, class T>
+    inline void decode(const t_bit_istream& is, T* out_buf, size_t n) const
+    {
+        is.align8();
+        uint32_t words;
+        std::memcpy(&words, is.cur_data8(), sizeof(words));
+        is.skip(32);
+        if (n) {
+            const uint32_t* in = (const uint32_t*)is.cur_data8();
+            if ((uintptr_t)in & 15) {
+                uint32_t* tmp = aligned(in_scratch, words);
+                std::memcpy(tmp, in, words * sizeof(uint32_t));
+                in = tmp;
+            }
+            bool direct = std::is_same<T, uint32_t>::value && ((uintptr_t)out_buf & 15) == 0;
+            size_t decoded = direct ? n : n + block_values; // capacity in, values decoded out
+            uint32_t* out = direct ? (uint32_t*)out_buf : aligned(out_scratch, decoded);
+            codec.decodeArray(in, words, out, decoded);
+            if (decoded != n) {
+                LOG(FATAL) << "fastpfor-decode: decoded " << decoded << " values instead of " << n;
+            }
+            if (!direct)
+                std::copy(out, out + n, out_buf);
+        }
+        is.skip(32 * words);
+    }
+
+    template <class t_bit_istream>
+    inline void skip(const t_bit_istream& is, size_t) const
+    {
+        is.align8();
+        uint32_t words;
+        std::memcpy(&words, is.cur_data8(), sizeof(words));
+        is.skip(32 + 32 * words);
+    }
+};
+
+/* binary packing of blocks of 128 values with SSE */
+struct simd_bp128 : fastpfor_codec<FastPForLib::CompositeCodec<FastPForLib::SIMDBinaryPacking, FastPForLib::VariableByte> > {
+    static std::string type()
+    {
+        return "simdbp128";
+    }
+};
+
+/* patched frame of reference on blocks of 128 values with SSE */
+struct simd_fastpfor : fastpfor_codec<FastPForLib::CompositeCodec<FastPForLib::SIMDFastPFor<4>, FastPForLib::VariableByte> > {
+    static std::string type()
+    {
+        return "simdfastpfor";
+    }
+};
+
 }
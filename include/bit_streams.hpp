@@ -156,7 +156,7 @@ public:
     {
         auto mod = in_word_offset % 8;
         if (mod != 0) {
-            in_word_offset += mod;
+            in_word_offset += (8 - mod);
             if (in_word_offset >= 64) {
                 data_ptr++;
                 in_word_offset = 0;
@@ -233,7 +233,7 @@ public:
     using value_type = sdsl::bit_vector::value_type;
     // constructor
     explicit bit_istream(const t_bv& bv, size_t start_offset = 0)
-        : m_bv(bv)
+        : m_bv(&bv)
         , data_ptr(bv.data() + (start_offset >> 6))
         , in_word_offset(start_offset % 64)
     {
@@ -244,6 +244,12 @@ public:
         , in_word_offset(is.in_word_offset)
     {
     }
+    // read from another container
+    void reset(const t_bv& bv, size_t start_offset = 0)
+    {
+        m_bv = &bv;
+        seek(start_offset);
+    }
     // get a bit
     value_type get() const
     {
@@ -344,17 +350,17 @@ public:
     }
     pos_type tellg() const
     {
-        std::ptrdiff_t cur_word_offset = data_ptr - m_bv.data();
+        std::ptrdiff_t cur_word_offset = data_ptr - m_bv->data();
         return (cur_word_offset << 6) + in_word_offset;
     }
     void seek(size_type offset) const
     {
-        data_ptr = m_bv.data() + (offset >> 6);
+        data_ptr = m_bv->data() + (offset >> 6);
         in_word_offset = offset & 0x3F;
     }
     bool eof() const
     {
-        return tellg() == m_bv.size();
+        return tellg() == m_bv->size();
     }
     explicit operator bool() const
     {
@@ -362,7 +368,7 @@ public:
     }
     const uint64_t* data() const
     {
-        return m_bv.data();
+        return m_bv->data();
     }
     const uint64_t* cur_data() const
     {
@@ -379,7 +385,7 @@ public:
     }
 
 private:
-    const t_bv& m_bv;
+    const t_bv* m_bv;
     mutable const uint64_t* data_ptr = nullptr;
     mutable uint8_t in_word_offset = 0;
 };
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+/*
+    read-only view of a bit sequence stored in 64-bit words, enough
+    for a bit_istream. like dict_view, the words are owned by the
+    store (a mapped factor file or a mapped store container).
+ */
+class bit_view {
+private:
+    const uint64_t* m_data = nullptr;
+    uint64_t m_size = 0;
+
+public:
+    bit_view() = default;
+    bit_view(const uint64_t* data, uint64_t size_in_bits)
+        : m_data(data)
+        , m_size(size_in_bits)
+    {
+    }
+
+    inline const uint64_t* data() const
+    {
+        return m_data;
+    }
+    /* size in bits */
+    inline uint64_t size() const
+    {
+        return m_size;
+    }
+    inline bool empty() const
+    {
+        return m_size == 0;
+    }
+};
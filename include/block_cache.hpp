@@ -0,0 +1,216 @@
+#pragma once
+
+#include "count_min_sketch.hpp"
+
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+struct block_cache_stats {
+    uint64_t hits = 0;
+    uint64_t misses = 0;
+    uint64_t evictions = 0;
+    uint64_t rejections = 0;
+    uint64_t cached_blocks = 0;
+    uint64_t cached_bytes = 0;
+
+    double hit_rate() const
+    {
+        auto lookups = hits + misses;
+        return lookups == 0 ? 0.0 : (double)hits / (double)lookups;
+    }
+};
+
+/*
+    memory bounded cache of decoded blocks keyed by block id.
+
+    the cache is split into shards, each protected by its own mutex.
+    every shard uses CLOCK eviction with a TinyLFU admission filter:
+    a new block only replaces the eviction candidate if it was
+    requested more often (as estimated by a count-min sketch that is
+    periodically halved). this keeps a long scan over cold blocks
+    from flushing the frequently used ones.
+ */
+class block_cache {
+public:
+    using value_type = std::shared_ptr<const std::vector<uint8_t> >;
+    using sketch_type = count_min_sketch<std::ratio<1, 1024>, std::ratio<1, 16> >;
+    static const size_t default_shards = 16;
+
+private:
+    struct slot {
+        uint64_t block_id;
+        value_type content;
+        bool referenced;
+    };
+    struct shard {
+        std::mutex mutex;
+        std::unordered_map<uint64_t, size_t> index;
+        std::vector<slot> slots;
+        std::vector<size_t> free_slots;
+        size_t clock_hand = 0;
+        size_t bytes = 0;
+        size_t capacity = 0;
+        sketch_type sketch;
+        uint64_t accesses = 0;
+        block_cache_stats stats;
+    };
+
+    std::vector<std::unique_ptr<shard> > m_shards;
+    size_t m_capacity;
+
+private:
+    shard& shard_of(uint64_t block_id) const
+    {
+        return *m_shards[block_id % m_shards.size()];
+    }
+
+    void record_access(shard& s, uint64_t block_id)
+    {
+        s.sketch.update(block_id);
+        // age the frequency estimates so old popularity fades out
+        if (++s.accesses >= 16 * (s.slots.size() + 64)) {
+            s.sketch.halve();
+            s.accesses = 0;
+        }
+    }
+
+    // advance the clock hand to the next unreferenced slot
+    size_t find_victim(shard& s)
+    {
+        while (true) {
+            if (s.clock_hand >= s.slots.size())
+                s.clock_hand = 0;
+            auto& v = s.slots[s.clock_hand];
+            if (v.content != nullptr) {
+                if (!v.referenced)
+                    return s.clock_hand;
+                v.referenced = false;
+            }
+            s.clock_hand++;
+        }
+    }
+
+    void evict(shard& s, size_t slot_id)
+    {
+        auto& v = s.slots[slot_id];
+        s.bytes -= v.content->size();
+        s.index.erase(v.block_id);
+        v.content.reset();
+        s.free_slots.push_back(slot_id);
+        s.stats.evictions++;
+    }
+
+    // make() creates the content once the block is admitted
+    template <class t_make>
+    bool insert(uint64_t block_id, size_t size, t_make make)
+    {
+        auto& s = shard_of(block_id);
+        if (size > s.capacity)
+            return false;
+        std::lock_guard<std::mutex> lock(s.mutex);
+        if (s.index.find(block_id) != s.index.end())
+            return true;
+        if (s.bytes + size > s.capacity) {
+            auto candidate_freq = s.sketch.estimate(block_id);
+            auto victim = find_victim(s);
+            if (candidate_freq <= s.sketch.estimate(s.slots[victim].block_id)) {
+                s.stats.rejections++;
+                return false;
+            }
+            evict(s, victim);
+            while (s.bytes + size > s.capacity) {
+                evict(s, find_victim(s));
+            }
+        }
+        slot v{ block_id, make(), false };
+        size_t slot_id;
+        if (!s.free_slots.empty()) {
+            slot_id = s.free_slots.back();
+            s.free_slots.pop_back();
+            s.slots[slot_id] = std::move(v);
+        }
+        else {
+            slot_id = s.slots.size();
+            s.slots.push_back(std::move(v));
+        }
+        s.index[block_id] = slot_id;
+        s.bytes += size;
+        return true;
+    }
+
+public:
+    block_cache(size_t capacity_bytes, size_t num_shards = default_shards)
+        : m_capacity(capacity_bytes)
+    {
+        if (num_shards == 0)
+            num_shards = 1;
+        for (size_t i = 0; i < num_shards; i++) {
+            m_shards.emplace_back(new shard());
+            m_shards.back()->capacity = capacity_bytes / num_shards;
+        }
+    }
+
+    value_type find(uint64_t block_id)
+    {
+        auto& s = shard_of(block_id);
+        std::lock_guard<std::mutex> lock(s.mutex);
+        record_access(s, block_id);
+        auto itr = s.index.find(block_id);
+        if (itr == s.index.end()) {
+            s.stats.misses++;
+            return nullptr;
+        }
+        s.stats.hits++;
+        auto& v = s.slots[itr->second];
+        v.referenced = true;
+        return v.content;
+    }
+
+    /* copies the block into the cache if the admission filter accepts it */
+    bool insert(uint64_t block_id, const uint8_t* content, size_t size)
+    {
+        return insert(block_id, size, [&]() {
+            return std::make_shared<const std::vector<uint8_t> >(content, content + size);
+        });
+    }
+
+    /* shares the block with the cache if the admission filter accepts it */
+    bool insert(uint64_t block_id, value_type content)
+    {
+        return insert(block_id, content->size(), [&]() { return content; });
+    }
+
+    void clear()
+    {
+        for (auto& sp : m_shards) {
+            std::lock_guard<std::mutex> lock(sp->mutex);
+            sp->index.clear();
+            sp->slots.clear();
+            sp->free_slots.clear();
+            sp->clock_hand = 0;
+            sp->bytes = 0;
+        }
+    }
+
+    block_cache_stats stats() const
+    {
+        block_cache_stats total;
+        for (const auto& sp : m_shards) {
+            std::lock_guard<std::mutex> lock(sp->mutex);
+            total.hits += sp->stats.hits;
+            total.misses += sp->stats.misses;
+            total.evictions += sp->stats.evictions;
+            total.rejections += sp->stats.rejections;
+            total.cached_blocks += sp->index.size();
+            total.cached_bytes += sp->bytes;
+        }
+        return total;
+    }
+
+    size_t capacity() const
+    {
+        return m_capacity;
+    }
+};
@@ -0,0 +1,303 @@
+#pragma once
+
+#include "block_cache.hpp"
+#include "io_ring.hpp"
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <exception>
+#include <fstream>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+/*
+    reads the encoded blocks of a factor stream with pread instead of
+    mapping the file. the blocks read are kept in a block_cache of their
+    own, so the memory used for the encoded text is capped and a scan by
+    one client cannot push the blocks of another out of the kernel page
+    cache. with O_DIRECT the page cache is bypassed completely; reads
+    are then widened to direct_io_alignment.
+
+    a block is returned as the 64-bit words holding its bits, starting
+    with the word of its first bit, so it can be read with a bit_istream.
+    read_blocks fetches many blocks at once through an io_ring and hands
+    each one over as soon as its read completes.
+ */
+class block_file_reader {
+public:
+    using value_type = block_cache::value_type;
+    static const uint64_t direct_io_alignment = 4096;
+    static const uint64_t padding_bytes = 16; // zeroed words after a block for look-ahead reads
+
+    struct block_request {
+        uint64_t block_id;
+        uint64_t bit_beg;
+        uint64_t bit_end;
+    };
+
+private:
+    /* the words of a bit range and the (for O_DIRECT aligned) bytes of the file to read */
+    struct extent {
+        uint64_t len; // bytes of the words
+        uint64_t file_beg; // file offset of the first word
+        uint64_t read_beg;
+        uint64_t read_len;
+    };
+
+    /* a read in flight */
+    struct pending {
+        size_t request;
+        extent ext;
+        std::shared_ptr<std::vector<uint8_t> > words;
+        std::unique_ptr<uint8_t, decltype(&free)> aligned{ nullptr, &free };
+    };
+
+    int m_fd = -1;
+    bool m_direct = false;
+    uint64_t m_data_offset; // file offset of bit 0 of the stream
+    uint64_t m_size; // in bits
+    mutable block_cache m_cache;
+
+    // reads up to len bytes, stops early at the end of the file
+    size_t read_at(uint8_t* buf, size_t len, uint64_t offset) const
+    {
+        size_t done = 0;
+        while (done < len) {
+            auto ret = pread(m_fd, buf + done, len - done, offset + done);
+            if (ret < 0) {
+                if (errno == EINTR)
+                    continue;
+                throw std::runtime_error("block_file_reader: pread failed: " + std::string(strerror(errno)));
+            }
+            if (ret == 0)
+                break;
+            done += ret;
+        }
+        return done;
+    }
+
+    extent extent_of(uint64_t bit_beg, uint64_t bit_end) const
+    {
+        extent ext;
+        uint64_t beg = (bit_beg >> 6) << 3;
+        uint64_t end = ((bit_end + 63) >> 6) << 3;
+        ext.len = end - beg;
+        ext.file_beg = m_data_offset + beg;
+        ext.read_beg = ext.file_beg;
+        ext.read_len = ext.len;
+        if (m_direct) {
+            /* O_DIRECT needs aligned offsets, lengths and memory */
+            ext.read_beg = ext.file_beg & ~(direct_io_alignment - 1);
+            auto read_end = (ext.file_beg + ext.len + direct_io_alignment - 1) & ~(direct_io_alignment - 1);
+            ext.read_len = read_end - ext.read_beg;
+        }
+        return ext;
+    }
+
+    static std::unique_ptr<uint8_t, decltype(&free)> aligned_buffer(size_t len)
+    {
+        void* scratch = nullptr;
+        if (posix_memalign(&scratch, direct_io_alignment, len) != 0) {
+            throw std::bad_alloc();
+        }
+        return std::unique_ptr<uint8_t, decltype(&free)>((uint8_t*)scratch, &free);
+    }
+
+    static void copy_aligned(const extent& ext, const uint8_t* aligned, uint64_t got, std::vector<uint8_t>& words)
+    {
+        auto skip = ext.file_beg - ext.read_beg;
+        if (got > skip)
+            std::memcpy(words.data(), aligned + skip, std::min<uint64_t>(got - skip, ext.len));
+    }
+
+public:
+    block_file_reader(const std::string& file_name, uint64_t data_offset, uint64_t size_in_bits,
+        size_t cache_bytes, bool direct_io)
+        : m_direct(direct_io)
+        , m_data_offset(data_offset)
+        , m_size(size_in_bits)
+        , m_cache(cache_bytes)
+    {
+        int flags = O_RDONLY;
+#ifdef O_DIRECT
+        if (direct_io)
+            flags |= O_DIRECT;
+#endif
+        m_fd = open(file_name.c_str(), flags);
+        if (m_fd < 0 && direct_io) {
+            // some file systems (tmpfs) do not support O_DIRECT
+            m_direct = false;
+            m_fd = open(file_name.c_str(), O_RDONLY);
+        }
+        if (m_fd < 0) {
+            throw std::runtime_error("LOAD FAILED: Cannot open " + file_name);
+        }
+    }
+
+    /* the bit vector stored in an sdsl file: a 64-bit size in bits followed by the words */
+    static block_file_reader* open_sdsl(const std::string& file_name, size_t cache_bytes, bool direct_io)
+    {
+        uint64_t size_in_bits = 0;
+        std::ifstream ifs(file_name, std::ios::binary);
+        if (!ifs.read((char*)&size_in_bits, sizeof(size_in_bits))) {
+            throw std::runtime_error("LOAD FAILED: Cannot read " + file_name);
+        }
+        return new block_file_reader(file_name, sizeof(uint64_t), size_in_bits, cache_bytes, direct_io);
+    }
+
+    block_file_reader(const block_file_reader&) = delete;
+    block_file_reader& operator=(const block_file_reader&) = delete;
+
+    ~block_file_reader()
+    {
+        if (m_fd >= 0)
+            close(m_fd);
+    }
+
+    /* size of the stream in bits */
+    uint64_t size() const
+    {
+        return m_size;
+    }
+
+    bool direct_io() const
+    {
+        return m_direct;
+    }
+
+    /* the words holding bits [bit_beg,bit_end) of block block_id */
+    value_type read(uint64_t block_id, uint64_t bit_beg, uint64_t bit_end) const
+    {
+        auto cached = m_cache.find(block_id);
+        if (cached != nullptr)
+            return cached;
+        auto words = read_words(bit_beg, bit_end);
+        m_cache.insert(block_id, words);
+        return words;
+    }
+
+    /* the words holding bits [bit_beg,bit_end), bypassing the cache */
+    value_type read_words(uint64_t bit_beg, uint64_t bit_end) const
+    {
+        auto ext = extent_of(bit_beg, bit_end);
+        auto buf = std::make_shared<std::vector<uint8_t> >(ext.len + padding_bytes, 0);
+        if (!m_direct) {
+            read_at(buf->data(), ext.len, ext.file_beg);
+            return buf;
+        }
+        auto aligned = aligned_buffer(ext.read_len);
+        auto got = read_at(aligned.get(), ext.read_len, ext.read_beg);
+        copy_aligned(ext, aligned.get(), got, *buf);
+        return buf;
+    }
+
+    /*
+        reads the blocks of a batch, at most queue_depth at a time, and
+        calls done(i, words) for request i as soon as its words are
+        available: cached blocks first, the others in completion order.
+        without io_uring (or with queue_depth 0) the blocks are read one
+        after another with pread.
+     */
+    template <class t_fn>
+    void read_blocks(const std::vector<block_request>& requests, size_t queue_depth, t_fn&& done) const
+    {
+        std::vector<size_t> misses;
+        for (size_t i = 0; i < requests.size(); i++) {
+            auto cached = m_cache.find(requests[i].block_id);
+            if (cached != nullptr)
+                done(i, cached);
+            else
+                misses.push_back(i);
+        }
+        if (misses.empty())
+            return;
+
+        std::vector<pending> slots(std::min(queue_depth, misses.size()));
+        std::unique_ptr<io_ring> ring;
+        if (misses.size() > 1 && !slots.empty()) {
+            ring.reset(new io_ring(slots.size()));
+            if (!ring->ok())
+                ring.reset();
+        }
+        if (!ring) {
+            for (auto i : misses) {
+                const auto& r = requests[i];
+                auto words = read_words(r.bit_beg, r.bit_end);
+                m_cache.insert(r.block_id, words);
+                done(i, words);
+            }
+            return;
+        }
+
+        size_t next = 0;
+        auto issue = [&](size_t slot) {
+            auto& p = slots[slot];
+            const auto& r = requests[misses[next++]];
+            p.request = &r - requests.data();
+            p.ext = extent_of(r.bit_beg, r.bit_end);
+            p.words = std::make_shared<std::vector<uint8_t> >(p.ext.len + padding_bytes, 0);
+            if (m_direct) {
+                p.aligned = aligned_buffer(p.ext.read_len);
+                ring->read(m_fd, p.aligned.get(), p.ext.read_len, p.ext.read_beg, slot);
+            }
+            else {
+                ring->read(m_fd, p.words->data(), p.ext.len, p.ext.file_beg, slot);
+            }
+        };
+        for (size_t slot = 0; slot < slots.size(); slot++)
+            issue(slot);
+        ring->submit();
+
+        /* the kernel writes into the slots until a read completes, so on an
+           error the reads still in flight are reaped before throwing */
+        std::exception_ptr error;
+        uint64_t slot;
+        int res;
+        while (ring->wait(slot, res)) {
+            if (error)
+                continue;
+            try {
+                auto& p = slots[slot];
+                if (res < 0) {
+                    throw std::runtime_error("block_file_reader: read failed: " + std::string(strerror(-res)));
+                }
+                // an O_DIRECT read may stop early at the end of the file, past the words needed
+                uint64_t expected = (p.ext.file_beg - p.ext.read_beg) + p.ext.len;
+                value_type words;
+                if ((uint64_t)res < expected) {
+                    // short read: finish synchronously
+                    words = read_words(requests[p.request].bit_beg, requests[p.request].bit_end);
+                }
+                else {
+                    if (m_direct)
+                        copy_aligned(p.ext, p.aligned.get(), res, *p.words);
+                    words = std::move(p.words);
+                }
+                auto request = p.request;
+                if (next < misses.size()) {
+                    issue(slot);
+                    ring->submit();
+                }
+                m_cache.insert(requests[request].block_id, words);
+                done(request, words);
+            }
+            catch (...) {
+                error = std::current_exception();
+            }
+        }
+        if (error)
+            std::rethrow_exception(error);
+    }
+
+    block_cache_stats cache_statistics() const
+    {
+        return m_cache.stats();
+    }
+};
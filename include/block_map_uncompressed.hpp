@@ -15,6 +15,7 @@ struct block_map_uncompressed {
 
     block_map_uncompressed() = default;
     block_map_uncompressed(block_map_uncompressed&&) = default;
+    block_map_uncompressed& operator=(block_map_uncompressed&&) = default;
 
     block_map_uncompressed(collection& col)
     {
@@ -49,6 +50,14 @@ struct block_map_uncompressed {
         m_block_factors.load(in);
     }
 
+    /* calls fn(ptr, bytes) for each memory region holding the map */
+    template <class t_fn>
+    void for_each_region(t_fn fn) const
+    {
+        fn((const void*)m_block_offsets.data(), ((m_block_offsets.bit_size() + 63) >> 6) << 3);
+        fn((const void*)m_block_factors.data(), ((m_block_factors.bit_size() + 63) >> 6) << 3);
+    }
+
     inline size_type block_offset(size_t block_id) const
     {
         return m_block_offsets[block_id];
@@ -0,0 +1,82 @@
+#pragma once
+
+#include "factor_data.hpp"
+
+#include "sdsl/int_vector.hpp"
+#include "sdsl/io.hpp"
+
+#include <memory>
+#include <stdexcept>
+#include <string>
+
+/*
+    state a factor coder shares across a whole collection, such as the
+    frequency tables of an entropy coder. it is trained once (count the
+    factors of some blocks, then build), stored in its own file
+    (KEY_FCODER) next to the dictionary and shared by all coder
+    instances of a store. a coder with a model defines model_type,
+    use_model() and model().
+ */
+struct no_coder_model {
+    using size_type = uint64_t;
+
+    void count(const block_factor_data&)
+    {
+    }
+    void build()
+    {
+    }
+    size_type serialize(std::ostream&, sdsl::structure_tree_node* = NULL, std::string = "") const
+    {
+        return 0;
+    }
+    void load(std::istream&)
+    {
+    }
+};
+
+template <class t_model>
+struct coder_model_void {
+    typedef void type;
+};
+
+/* coders without a model: all hooks do nothing */
+template <class t_coder, class = void>
+struct coder_model {
+    using type = no_coder_model;
+    enum { required = false };
+
+    static std::shared_ptr<const type> load(const std::string&)
+    {
+        return nullptr;
+    }
+    static void use(t_coder&, const std::shared_ptr<const type>&)
+    {
+    }
+    static void copy(t_coder&, const t_coder&)
+    {
+    }
+};
+
+template <class t_coder>
+struct coder_model<t_coder, typename coder_model_void<typename t_coder::model_type>::type> {
+    using type = typename t_coder::model_type;
+    enum { required = true };
+
+    static std::shared_ptr<const type> load(const std::string& file_name)
+    {
+        std::shared_ptr<type> model(new type());
+        if (!sdsl::load_from_file(*model, file_name)) {
+            throw std::runtime_error("LOAD FAILED: Cannot load factor coder model " + file_name);
+        }
+        return model;
+    }
+    static void use(t_coder& coder, const std::shared_ptr<const type>& model)
+    {
+        coder.use_model(model);
+    }
+    static void copy(t_coder& to, const t_coder& from)
+    {
+        to.use_model(from.model());
+    }
+};
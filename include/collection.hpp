@@ -15,19 +15,24 @@ const std::string KEY_FACTORIZED_TEXT = "FACTORS";
 const std::string KEY_BLOCKMAP = "BLOCKMAP";
 const std::string KEY_BLOCKOFFSETS = "BLOCKOFFSETS";
 const std::string KEY_BLOCKFACTORS = "BLOCKFACTORS";
+const std::string KEY_SKIPINDEX = "SKIPINDEX";
 const std::string KEY_FCODER = "FCODER";
 const std::string KEY_DICT_STATISTICS = "DICT_STATS";
 const std::string KEY_LZ = "LZ";
 const std::string KEY_DOCORDER = "DOCORDER";
 const std::string KEY_URLORDER = "URLORDER";
+const std::string KEY_DOCNOINDEX = "DOCNOINDEX";
+const std::string KEY_MANIFEST = "MANIFEST";
 
 const std::string PARAM_DICT_HASH = "DICT_HASH";
+const std::string PARAM_TEXT_SIZE = "TEXT_SIZE";
 
 struct collection {
     std::string path;
     std::map<std::string, std::string> param_map;
     std::map<std::string, std::string> file_map;
-    collection(const std::string& p)
+    /* stores opened through their manifest do not need the text */
+    collection(const std::string& p, bool require_text = true)
         : path(p + "/")
     {
         if (!utils::directory_exists(path)) {
@@ -47,12 +52,21 @@ struct collection {
         auto file_name = path + "/" + KEY_PREFIX + KEY_TEXT;
         file_map[KEY_TEXT] = file_name;
         if (!utils::file_exists(path + "/" + KEY_PREFIX + KEY_TEXT)) {
-            LOG(FATAL) << "Collection path does not contain text.";
-            throw std::runtime_error("Collection path does not contain text.");
+            if (require_text) {
+                LOG(FATAL) << "Collection path does not contain text.";
+                throw std::runtime_error("Collection path does not contain text.");
+            }
+            LOG(INFO) << "Collection path does not contain text.";
+            file_map.erase(KEY_TEXT);
         }
         else {
             sdsl::int_vector_mapped_buffer<8> text(file_map[KEY_TEXT]);
             LOG(INFO) << "Found input text with size " << text.size() / (1024.0 * 1024.0) << " MiB";
+            param_map[PARAM_TEXT_SIZE] = std::to_string(text.size());
+        }
+        auto docorder_file = path + "/" + KEY_PREFIX + KEY_DOCORDER;
+        if (utils::file_exists(docorder_file)) {
+            file_map[KEY_DOCORDER] = docorder_file;
         }
     }
 
@@ -65,6 +79,15 @@ struct collection {
         return std::to_string(crc32);
     }
 
+    uint64_t text_size()
+    {
+        if (param_map.count(PARAM_TEXT_SIZE) == 0) {
+            const sdsl::int_vector_mapper<8, std::ios_base::in> text(file_map[KEY_TEXT]);
+            param_map[PARAM_TEXT_SIZE] = std::to_string(text.size());
+        }
+        return std::stoull(param_map[PARAM_TEXT_SIZE]);
+    }
+
     std::string temp_file_name(const std::string& key, size_t offset)
     {
         auto file_name = path + "/tmp/" + key + "-" + std::to_string(offset) + "-" + std::to_string(getpid()) + ".sdsl";
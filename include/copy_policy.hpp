@@ -0,0 +1,76 @@
+#pragma once
+
+#include <algorithm>
+#include <cstring>
+#include <string>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+/*
+    policies used to materialise factors during block decoding.
+    src_end and dst_end bound the readable source and the writable
+    output so a policy may decide how far it is allowed to overrun.
+    the source never overlaps the destination (local factors that
+    may overlap are always copied with std::copy).
+ */
+struct copy_std {
+    static std::string type()
+    {
+        return "copy_std";
+    }
+
+    static inline uint8_t* copy(const uint8_t* src, size_t len, uint8_t* dst, const uint8_t*, const uint8_t*)
+    {
+        return std::copy(src, src + len, dst);
+    }
+};
+
+/*
+    lz4 style wild copy: moves the factor in fixed size chunks and
+    may write up to chunk_size-1 bytes past its end. factors close to
+    the end of the dictionary or the output buffer, where such an
+    overrun would leave the buffers, fall back to std::copy.
+ */
+struct copy_wild {
+#if defined(__AVX2__)
+    enum { chunk_size = 32 };
+#else
+    enum { chunk_size = 16 };
+#endif
+
+    static std::string type()
+    {
+        return "copy_wild";
+    }
+
+    static inline void copy_chunk(const uint8_t* src, uint8_t* dst)
+    {
+#if defined(__AVX2__)
+        _mm256_storeu_si256((__m256i*)dst, _mm256_loadu_si256((const __m256i*)src));
+#elif defined(__SSE2__)
+        _mm_storeu_si128((__m128i*)dst, _mm_loadu_si128((const __m128i*)src));
+#else
+        std::memcpy(dst, src, chunk_size);
+#endif
+    }
+
+    static inline uint8_t* copy(const uint8_t* src, size_t len, uint8_t* dst, const uint8_t* src_end,
+        const uint8_t* dst_end)
+    {
+        if (src + len + chunk_size > src_end || dst + len + chunk_size > dst_end) {
+            return std::copy(src, src + len, dst);
+        }
+        auto out = dst;
+        auto out_end = dst + len;
+        do {
+            copy_chunk(src, out);
+            src += chunk_size;
+            out += chunk_size;
+        } while (out < out_end);
+        return out_end;
+    }
+};
@@ -178,6 +178,15 @@ public:
         sdsl::read_member(m_total_count, in);
     }
 
+    /* decay all counts, used to age out old frequencies */
+    void halve()
+    {
+        for (size_t i = 0; i < m_table.size(); i++) {
+            m_table[i] = m_table[i] >> 1;
+        }
+        m_total_count >>= 1;
+    }
+
     void merge(const count_min_sketch<t_epsilon, t_delta>& cms)
     {
         for (size_t i = 0; i < m_table.size(); i++) {
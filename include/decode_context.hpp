@@ -0,0 +1,112 @@
+#pragma once
+
+#include "bit_streams.hpp"
+#include "bit_view.hpp"
+#include "block_cache.hpp"
+#include "coder_model.hpp"
+#include "factor_data.hpp"
+
+#include "sdsl/int_vector_mapper.hpp"
+
+#include <atomic>
+#include <memory>
+#include <type_traits>
+#include <vector>
+
+/*
+    per-thread decoding state: the stream cursor, the coder state
+    (z_stream etc.) and the factor scratch space. the stores
+    themselves are immutable, so any number of threads can decode
+    from the same store as long as each uses its own context.
+ */
+template <class t_coder, class t_bv = sdsl::int_vector_mapper<1, std::ios_base::in> >
+struct decode_context {
+    using coder_type = t_coder;
+    using stream_type = bit_istream<t_bv>;
+
+    stream_type stream;
+    coder_type coder;
+    block_factor_data bfd;
+    size_t replica = 0; // numa replica of the store components used by this context
+    std::vector<uint8_t> text; // a whole decoded block for partial reads, sized on first use
+    // the block last fetched by a pread backend (see block_file_reader) and the view the stream reads from
+    block_cache::value_type fetched_block;
+    uint64_t fetched_id = 0;
+    bit_view fetched;
+
+    decode_context(const t_bv& bv, size_t block_size)
+        : stream(bv)
+    {
+        bfd.reset();
+        if (block_size)
+            bfd.resize(block_size, factor_layout::of<t_coder>());
+    }
+
+    // coders own non-copyable state, so a copy starts with a fresh coder sharing the model
+    decode_context(const decode_context& ctx)
+        : stream(ctx.stream)
+        , bfd(ctx.bfd)
+        , replica(ctx.replica)
+        , fetched_block(ctx.fetched_block)
+        , fetched_id(ctx.fetched_id)
+        , fetched(ctx.fetched)
+    {
+        coder_model<t_coder>::copy(coder, ctx.coder);
+        if (fetched_block)
+            read_fetched(std::is_same<t_bv, bit_view>(), ctx.stream.tellg());
+    }
+
+    decode_context& operator=(const decode_context&) = delete;
+
+    /* points the stream at the fetched block */
+    void read_fetched(std::true_type, size_t start_offset)
+    {
+        stream.reset(fetched, start_offset);
+    }
+    void read_fetched(std::false_type, size_t)
+    {
+    }
+};
+
+/* a process-wide unique id for each store instance, used to key per-thread scratch */
+inline uint64_t next_store_id()
+{
+    static std::atomic<uint64_t> id(0);
+    return ++id;
+}
+
+/*
+    the decode contexts a thread keeps for the stores it decodes from
+    without passing a context (decode_block_into), so repeated calls do
+    not allocate coder state and factor buffers. a thread keeps contexts
+    for the last max_stores stores it used.
+ */
+template <class t_ctx>
+struct scratch_contexts {
+    static const size_t max_stores = 4;
+
+    struct entry {
+        uint64_t store_id;
+        std::unique_ptr<t_ctx> ctx;
+    };
+
+    template <class t_store>
+    static t_ctx& get(const t_store& store)
+    {
+        static thread_local std::vector<entry> entries;
+        static thread_local size_t next_victim = 0;
+        for (auto& e : entries) {
+            if (e.store_id == store.store_id())
+                return *e.ctx;
+        }
+        std::unique_ptr<t_ctx> ctx(new t_ctx(store.create_context()));
+        if (entries.size() < max_stores) {
+            entries.push_back({ store.store_id(), std::move(ctx) });
+            return *entries.back().ctx;
+        }
+        auto& e = entries[next_victim++ % max_stores];
+        e.store_id = store.store_id();
+        e.ctx = std::move(ctx);
+        return *e.ctx;
+    }
+};
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+/*
+    read-only view of the dictionary bytes. the memory is owned by the
+    store, which either loads the dictionary onto the heap or maps it.
+ */
+class dict_view {
+private:
+    const uint8_t* m_data = nullptr;
+    size_t m_size = 0;
+
+public:
+    typedef const uint8_t* const_iterator;
+
+    dict_view() = default;
+    dict_view(const uint8_t* data, size_t size)
+        : m_data(data)
+        , m_size(size)
+    {
+    }
+
+    inline const uint8_t* data() const
+    {
+        return m_data;
+    }
+    inline size_t size() const
+    {
+        return m_size;
+    }
+    inline bool empty() const
+    {
+        return m_size == 0;
+    }
+    inline uint8_t operator[](size_t i) const
+    {
+        return m_data[i];
+    }
+    inline const_iterator begin() const
+    {
+        return m_data;
+    }
+    inline const_iterator end() const
+    {
+        return m_data + m_size;
+    }
+};
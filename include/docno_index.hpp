@@ -0,0 +1,224 @@
+#pragma once
+
+#include "utils.hpp"
+#include "collection.hpp"
+#include "batch_extract.hpp"
+
+#include <sdsl/int_vector.hpp>
+
+#include <fstream>
+#include <numeric>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+
+/*
+    maps document numbers (the DOCNO strings written to text.DOCORDER
+    by create-collection.x) and document ids (their position in that
+    file) to text ranges. a document spans the text from its DOCORDER
+    offset to the offset of the next document. the docno strings are
+    concatenated in one buffer and located by binary search over a
+    permutation sorted by docno.
+ */
+class docno_index {
+public:
+    typedef typename sdsl::int_vector<>::size_type size_type;
+
+private:
+    uint64_t m_text_size = 0;
+    sdsl::int_vector<> m_doc_starts;
+    sdsl::int_vector<8> m_docnos;
+    sdsl::int_vector<> m_docno_starts;
+    sdsl::int_vector<> m_sorted_ids;
+
+private:
+    int compare_docno(uint64_t doc_id, const std::string& docno) const
+    {
+        auto beg = m_docno_starts[doc_id];
+        auto len = m_docno_starts[doc_id + 1] - beg;
+        auto ptr = (const char*)m_docnos.data() + beg;
+        auto cmp = docno.compare(0, docno.size(), ptr, len);
+        return -cmp;
+    }
+
+public:
+    static std::string type()
+    {
+        return "docno_index";
+    }
+
+    static std::string file_name(collection& col)
+    {
+        return col.path + "/index/" + KEY_DOCNOINDEX + "-" + type() + ".sdsl";
+    }
+
+    /* builds the index if the collection has a document order file */
+    static void create(collection& col, bool rebuild)
+    {
+        if (col.file_map.count(KEY_DOCORDER) == 0) {
+            LOG(INFO) << "No document order file. Skipping docno index.";
+            return;
+        }
+        auto docnoindex_file = file_name(col);
+        if (rebuild || !utils::file_exists(docnoindex_file)) {
+            docno_index tmp(col);
+            sdsl::store_to_file(tmp, docnoindex_file);
+        }
+        col.file_map[KEY_DOCNOINDEX] = docnoindex_file;
+    }
+
+    docno_index() = default;
+    docno_index(docno_index&&) = default;
+    docno_index& operator=(docno_index&&) = default;
+
+    docno_index(collection& col)
+    {
+        LOG(INFO) << "\tCreate docno index from " << col.file_map[KEY_DOCORDER];
+        std::ifstream dof(col.file_map[KEY_DOCORDER]);
+        if (!dof) {
+            throw std::runtime_error("Cannot open document order file.");
+        }
+        m_text_size = col.text_size();
+        std::vector<std::string> docnos;
+        std::vector<uint64_t> doc_starts;
+        std::string line;
+        size_t line_no = 0;
+        while (std::getline(dof, line)) {
+            line_no++;
+            if (line.empty())
+                continue;
+            /* each line is "<docno> <text offset>" with offsets strictly increasing */
+            std::istringstream iss(line);
+            std::string docno, rest;
+            uint64_t pos;
+            if (!(iss >> docno >> pos) || (iss >> rest)) {
+                throw std::runtime_error("Malformed document order file: line " + std::to_string(line_no));
+            }
+            if (!doc_starts.empty() && pos <= doc_starts.back()) {
+                throw std::runtime_error("Document offsets not increasing in document order file: line "
+                    + std::to_string(line_no));
+            }
+            if (pos >= m_text_size) {
+                throw std::runtime_error("Document offset beyond the text in document order file: line "
+                    + std::to_string(line_no));
+            }
+            docnos.push_back(docno);
+            doc_starts.push_back(pos);
+        }
+        if (!dof.eof()) {
+            throw std::runtime_error("Cannot read document order file: line " + std::to_string(line_no + 1));
+        }
+        size_t num_docs = docnos.size();
+        size_t docno_bytes = 0;
+        for (const auto& d : docnos)
+            docno_bytes += d.size();
+
+        m_doc_starts = sdsl::int_vector<>(num_docs);
+        m_docno_starts = sdsl::int_vector<>(num_docs + 1);
+        m_docnos = sdsl::int_vector<8>(docno_bytes);
+        size_t cur = 0;
+        for (size_t i = 0; i < num_docs; i++) {
+            m_doc_starts[i] = doc_starts[i];
+            m_docno_starts[i] = cur;
+            for (const auto c : docnos[i])
+                m_docnos[cur++] = (uint8_t)c;
+        }
+        m_docno_starts[num_docs] = cur;
+
+        std::vector<uint64_t> ids(num_docs);
+        std::iota(ids.begin(), ids.end(), 0);
+        std::sort(ids.begin(), ids.end(), [&](uint64_t a, uint64_t b) { return docnos[a] < docnos[b]; });
+        m_sorted_ids = sdsl::int_vector<>(num_docs);
+        for (size_t i = 0; i < num_docs; i++)
+            m_sorted_ids[i] = ids[i];
+
+        sdsl::util::bit_compress(m_doc_starts);
+        sdsl::util::bit_compress(m_docno_starts);
+        sdsl::util::bit_compress(m_sorted_ids);
+        LOG(INFO) << "\tIndexed " << num_docs << " documents";
+    }
+
+    inline size_type serialize(std::ostream& out, sdsl::structure_tree_node* v = NULL, std::string name = "") const
+    {
+        using namespace sdsl;
+        structure_tree_node* child = structure_tree::add_child(v, name, sdsl::util::class_name(*this));
+        size_type written_bytes = 0;
+        written_bytes += sdsl::write_member(m_text_size, out, child, "text_size");
+        written_bytes += m_doc_starts.serialize(out, child, "doc_starts");
+        written_bytes += m_docnos.serialize(out, child, "docnos");
+        written_bytes += m_docno_starts.serialize(out, child, "docno_starts");
+        written_bytes += m_sorted_ids.serialize(out, child, "sorted_ids");
+        sdsl::structure_tree::add_size(child, written_bytes);
+        return written_bytes;
+    }
+
+    inline void load(std::istream& in)
+    {
+        sdsl::read_member(m_text_size, in);
+        m_doc_starts.load(in);
+        m_docnos.load(in);
+        m_docno_starts.load(in);
+        m_sorted_ids.load(in);
+    }
+
+    size_type size_in_bytes() const
+    {
+        return sdsl::size_in_bytes(*this);
+    }
+
+    size_type num_docs() const
+    {
+        return m_doc_starts.size();
+    }
+
+    bool empty() const
+    {
+        return num_docs() == 0;
+    }
+
+    /* returns num_docs() if the docno is unknown */
+    uint64_t doc_id(const std::string& docno) const
+    {
+        size_t lb = 0;
+        size_t rb = m_sorted_ids.size();
+        while (lb < rb) {
+            size_t mid = lb + (rb - lb) / 2;
+            if (compare_docno(m_sorted_ids[mid], docno) < 0)
+                lb = mid + 1;
+            else
+                rb = mid;
+        }
+        if (lb < m_sorted_ids.size() && compare_docno(m_sorted_ids[lb], docno) == 0)
+            return m_sorted_ids[lb];
+        return num_docs();
+    }
+
+    std::string docno(uint64_t doc_id) const
+    {
+        auto beg = m_docno_starts[doc_id];
+        auto end = m_docno_starts[doc_id + 1];
+        return std::string((const char*)m_docnos.data() + beg, end - beg);
+    }
+
+    /* text range [first,second) of the document */
+    std::pair<uint64_t, uint64_t> doc_range(uint64_t doc_id) const
+    {
+        uint64_t end = (doc_id + 1 < num_docs()) ? m_doc_starts[doc_id + 1] : m_text_size;
+        return std::make_pair(m_doc_starts[doc_id], end);
+    }
+};
+
+/* decodes a document; with num_threads > 1 its blocks are decoded in parallel */
+template <class t_idx>
+std::vector<uint8_t> extract_document(const t_idx& idx, const docno_index& docs, uint64_t doc_id, size_t num_threads)
+{
+    if (doc_id >= docs.num_docs()) {
+        throw std::out_of_range("extract_document: unknown document");
+    }
+    auto range = docs.doc_range(doc_id);
+    std::vector<uint8_t> document(range.second - range.first);
+    std::vector<text_range> ranges{ { range.first, document.size() } };
+    std::vector<uint8_t*> out{ document.data() };
+    extract_batch(idx, ranges, out, num_threads);
+    return document;
+}
@@ -4,9 +4,14 @@
 #include "collection.hpp"
 #include "bit_coders.hpp"
 #include "factor_data.hpp"
+#include "coder_model.hpp"
+#include "rans.hpp"
 
 #include <sdsl/suffix_arrays.hpp>
 
+#include <cstring>
+#include <memory>
+
 struct coder_size_info {
     uint32_t literal_bytes = 0;
     uint32_t length_bytes = 0;
@@ -23,6 +28,8 @@ template <uint32_t t_literal_threshold = 1,
 struct factor_coder_blocked {
     typedef typename sdsl::int_vector<>::size_type size_type;
     enum { literal_threshold = t_literal_threshold };
+    enum { fused_decoding = coder::skippable<t_coder_literal>::value && coder::skippable<t_coder_offset>::value };
+    enum { two_stream = false };
     t_coder_literal literal_coder;
     t_coder_offset offset_coder;
     t_coder_len len_coder;
@@ -47,27 +54,16 @@ struct factor_coder_blocked {
     coder_size_info decode_block(t_istream& ifs, block_factor_data& bfd, size_t num_factors) const
     {
         coder_size_info csi;
-        bfd.num_factors = num_factors;
 
         auto len_pos = ifs.tellg();
-        len_coder.decode(ifs, bfd.lengths.data(), num_factors);
+        decode_lengths(ifs, bfd, num_factors);
         csi.length_bytes = (ifs.tellg() - len_pos) / 8;
 
-        std::for_each(bfd.lengths.begin(), bfd.lengths.begin() + num_factors, [](uint32_t& n) { n++; });
-        bfd.num_literals = 0;
-        auto num_literal_factors = 0;
-        for (size_t i = 0; i < bfd.num_factors; i++) {
-            if (bfd.lengths[i] <= literal_threshold) {
-                bfd.num_literals += bfd.lengths[i];
-                num_literal_factors++;
-            }
-        }
         if (bfd.num_literals) {
             auto lit_pos = ifs.tellg();
             literal_coder.decode(ifs, bfd.literals.data(), bfd.num_literals);
             csi.literal_bytes = (ifs.tellg() - lit_pos) / 8;
         }
-        bfd.num_offsets = bfd.num_factors - num_literal_factors;
         if (bfd.num_offsets) {
             auto off_pos = ifs.tellg();
             offset_coder.decode(ifs, bfd.offsets.data(), bfd.num_offsets);
@@ -75,6 +71,106 @@ struct factor_coder_blocked {
         }
         return csi;
     }
+
+    /* single pass text reconstruction for skippable literal and offset coders.
+       after the lengths are decoded, the literal stream is read through a
+       second cursor while the factors are written straight to out, so the
+       literals and offsets are never materialised in bfd. with local search,
+       offsets below block_size refer to the text of the block itself.
+       bfd.lengths is only used as scratch and the counts of bfd are not
+       touched, so bfd does not describe the block afterwards */
+    template <bool t_local, class t_copy_policy, class t_istream>
+    uint64_t decode_block_text(t_istream& ifs, block_factor_data& bfd, size_t num_factors,
+        const uint8_t* dict, uint64_t dict_size, uint64_t block_size, uint8_t* out, uint8_t* out_end) const
+    {
+        const uint8_t* dict_end = dict + dict_size;
+        auto lengths = bfd.lengths.data();
+        len_coder.decode(ifs, lengths, num_factors);
+        size_t num_literals = 0;
+        for (size_t i = 0; i < num_factors; i++) {
+            auto factor_len = lengths[i] + 1;
+            if (factor_len <= literal_threshold)
+                num_literals += factor_len;
+        }
+        t_istream literal_stream(ifs);
+        if (num_literals)
+            literal_coder.skip(ifs, num_literals);
+
+        auto out_itr = out;
+        for (size_t i = 0; i < num_factors; i++) {
+            uint32_t factor_len = lengths[i] + 1;
+            if (factor_len <= literal_threshold) {
+                literal_coder.decode(literal_stream, out_itr, factor_len);
+            }
+            else {
+                uint32_t factor_offset;
+                offset_coder.decode(ifs, &factor_offset, 1);
+                if (t_local && factor_offset < block_size) {
+                    std::copy(out + factor_offset, out + factor_offset + factor_len, out_itr);
+                }
+                else {
+                    const uint8_t* src = dict + factor_offset;
+                    if (t_local)
+                        src -= block_size;
+                    t_copy_policy::copy(src, factor_len, out_itr, dict_end, out_end);
+                }
+            }
+            out_itr += factor_len;
+        }
+        return out_itr - out;
+    }
+
+    /* decodes the factor lengths and counts the literals and offsets
+       of the block. the stream is left at the start of the literals */
+    template <class t_istream>
+    void decode_lengths(t_istream& ifs, block_factor_data& bfd, size_t num_factors) const
+    {
+        bfd.num_factors = num_factors;
+        len_coder.decode(ifs, bfd.lengths.data(), num_factors);
+        std::for_each(bfd.lengths.begin(), bfd.lengths.begin() + num_factors, [](uint32_t& n) { n++; });
+        bfd.num_literals = 0;
+        size_t num_literal_factors = 0;
+        for (size_t i = 0; i < bfd.num_factors; i++) {
+            if (bfd.lengths[i] <= literal_threshold) {
+                bfd.num_literals += bfd.lengths[i];
+                num_literal_factors++;
+            }
+        }
+        bfd.num_offsets = bfd.num_factors - num_literal_factors;
+    }
+
+    /* after decode_lengths: decodes the literals [literal_begin,literal_end)
+       and offsets [offset_begin,offset_end) to their positions in bfd.
+       fixed width coders skip everything else, other coders decode it all */
+    template <class t_istream>
+    void decode_range(t_istream& ifs, block_factor_data& bfd, size_t literal_begin, size_t literal_end,
+        size_t offset_begin, size_t offset_end) const
+    {
+        if (bfd.num_literals) {
+            decode_part(literal_coder, ifs, bfd.literals.data(), bfd.num_literals, literal_begin, literal_end,
+                std::integral_constant<bool, coder::fixed_width_traits<t_coder_literal>::random_access>());
+        }
+        if (bfd.num_offsets && offset_begin != offset_end) {
+            decode_part(offset_coder, ifs, bfd.offsets.data(), bfd.num_offsets, offset_begin, offset_end,
+                std::integral_constant<bool, coder::fixed_width_traits<t_coder_offset>::random_access>());
+        }
+    }
+
+private:
+    template <class t_coder, class t_istream, class T>
+    static void decode_part(const t_coder& c, t_istream& ifs, T* buf, size_t n, size_t begin, size_t end, std::true_type)
+    {
+        coder::fixed_width_traits<t_coder>::skip(ifs, begin);
+        if (end != begin)
+            c.decode(ifs, buf + begin, end - begin);
+        coder::fixed_width_traits<t_coder>::skip(ifs, n - end);
+    }
+
+    template <class t_coder, class t_istream, class T>
+    static void decode_part(const t_coder& c, t_istream& ifs, T* buf, size_t n, size_t, size_t, std::false_type)
+    {
+        c.decode(ifs, buf, n);
+    }
 };
 
 /*
@@ -86,6 +182,8 @@ template <uint32_t t_literal_threshold = 1,
 struct factor_coder_blocked_twostream {
     typedef typename sdsl::int_vector<>::size_type size_type;
     enum { literal_threshold = t_literal_threshold };
+    enum { fused_decoding = false };
+    enum { two_stream = true };
 
 private:
     t_coder_offset offsetliteral_coder;
@@ -108,22 +206,456 @@ public:
     }
 
     template <class t_istream>
-    void decode_block(t_istream& ifs, block_factor_data& bfd, size_t num_factors) const
+    coder_size_info decode_block(t_istream& ifs, block_factor_data& bfd, size_t num_factors) const
     {
+        coder_size_info csi;
         bfd.num_factors = num_factors;
+        auto len_pos = ifs.tellg();
         len_coder.decode(ifs, bfd.lengths.data(), num_factors);
-        offsetliteral_coder.decode(ifs, bfd.offset_literals.data(), num_factors);
-        std::for_each(bfd.lengths.begin(), bfd.lengths.begin() + num_factors, [](uint32_t& n) { n++; });
+        csi.length_bytes = (ifs.tellg() - len_pos) / 8;
+        // a literal factor stores all of its literals in the combined stream, a copy its offset
+        bfd.num_offset_literals = 0;
+        for (size_t i = 0; i < num_factors; i++) {
+            auto len = ++bfd.lengths[i];
+            bfd.num_offset_literals += (len <= literal_threshold) ? len : 1;
+        }
+        auto off_pos = ifs.tellg();
+        offsetliteral_coder.decode(ifs, bfd.offset_literals.data(), bfd.num_offset_literals);
+        csi.offset_bytes = (ifs.tellg() - off_pos) / 8;
         bfd.num_literals = 0;
         bfd.num_offsets = 0;
-        for (size_t i = 0; i < bfd.num_factors; i++) {
-            if (bfd.lengths[i] <= literal_threshold) {
-                std::copy(bfd.offset_literals.begin() + i, bfd.offset_literals.begin() + i + bfd.lengths[i], bfd.literals.begin() + bfd.num_literals);
-                bfd.num_literals += bfd.lengths[i];
+        size_t pos = 0;
+        for (size_t i = 0; i < num_factors; i++) {
+            auto len = bfd.lengths[i];
+            if (len <= literal_threshold) {
+                for (size_t j = 0; j < len; j++)
+                    bfd.literals[bfd.num_literals++] = bfd.offset_literals[pos++];
+            }
+            else {
+                bfd.offsets[bfd.num_offsets++] = bfd.offset_literals[pos++];
+            }
+        }
+        return csi;
+    }
+
+    /* the literals are interleaved with the offsets, so this decodes the whole block */
+    template <class t_istream>
+    void decode_lengths(t_istream& ifs, block_factor_data& bfd, size_t num_factors) const
+    {
+        decode_block(ifs, bfd, num_factors);
+    }
+
+    /* after decode_lengths everything is decoded already */
+    template <class t_istream>
+    void decode_range(t_istream&, block_factor_data&, size_t, size_t, size_t, size_t) const
+    {
+    }
+};
+
+/*
+    the preset dictionaries of factor_coder_blocked_twostream_primed, one
+    per stream: slices of the start of the streams of evenly spaced
+    sampled blocks, t_prime_size bytes in total.
+ */
+template <uint32_t t_prime_size>
+struct zlib_prime_model {
+    using size_type = uint64_t;
+    static const size_t num_slices = 16;
+    sdsl::int_vector<8> lengths;
+    sdsl::int_vector<8> offset_literals;
+    // the start of the streams of the blocks seen so far, only used for training
+    std::vector<std::vector<uint8_t> > length_samples;
+    std::vector<std::vector<uint8_t> > offset_literal_samples;
+
+private:
+    static std::vector<uint8_t> slice(const uint32_t* stream, size_t n)
+    {
+        auto bytes = (const uint8_t*)stream;
+        return std::vector<uint8_t>(bytes, bytes + std::min<size_t>(n * sizeof(uint32_t), t_prime_size / num_slices));
+    }
+
+    static void pick(const std::vector<std::vector<uint8_t> >& samples, sdsl::int_vector<8>& dict)
+    {
+        std::vector<uint8_t> bytes;
+        size_t step = std::max<size_t>(1, samples.size() / num_slices);
+        for (size_t i = 0; i < samples.size() && bytes.size() < t_prime_size; i += step) {
+            auto len = std::min<size_t>(samples[i].size(), t_prime_size - bytes.size());
+            bytes.insert(bytes.end(), samples[i].begin(), samples[i].begin() + len);
+        }
+        dict.resize(bytes.size());
+        std::copy(bytes.begin(), bytes.end(), dict.begin());
+    }
+
+public:
+    void count(const block_factor_data& bfd)
+    {
+        // the bytes the coder compresses: lengths-1 and the combined offsets and literals
+        std::vector<uint32_t> lens(bfd.lengths.begin(), bfd.lengths.begin() + bfd.num_factors);
+        for (auto& len : lens)
+            len--;
+        length_samples.push_back(slice(lens.data(), lens.size()));
+        offset_literal_samples.push_back(slice(bfd.offset_literals.data(), bfd.num_offset_literals));
+    }
+
+    void build()
+    {
+        pick(length_samples, lengths);
+        pick(offset_literal_samples, offset_literals);
+    }
+
+    size_type serialize(std::ostream& out, sdsl::structure_tree_node* v = NULL, std::string name = "") const
+    {
+        using namespace sdsl;
+        structure_tree_node* child = structure_tree::add_child(v, name, sdsl::util::class_name(*this));
+        size_type written_bytes = 0;
+        written_bytes += lengths.serialize(out, child, "lengths");
+        written_bytes += offset_literals.serialize(out, child, "offset_literals");
+        sdsl::structure_tree::add_size(child, written_bytes);
+        return written_bytes;
+    }
+
+    void load(std::istream& in)
+    {
+        lengths.load(in);
+        offset_literals.load(in);
+    }
+};
+
+/*
+    encode factors in blocks as two streams whose zlib streams are primed
+    with preset dictionaries sampled from the factor streams once per
+    collection (see zlib_prime_model). small blocks give zlib little
+    context of their own, the dictionaries make up for it without larger
+    blocks. the coders have to support prime(), i.e. be coder::zlib.
+ */
+template <uint32_t t_literal_threshold = 1,
+    class t_coder_offset = coder::zlib<9>,
+    class t_coder_len = coder::zlib<9>,
+    uint32_t t_prime_size = 32768>
+struct factor_coder_blocked_twostream_primed {
+    typedef typename sdsl::int_vector<>::size_type size_type;
+    enum { literal_threshold = t_literal_threshold };
+    enum { fused_decoding = false };
+    enum { two_stream = true };
+    using model_type = zlib_prime_model<t_prime_size>;
+
+private:
+    t_coder_offset offsetliteral_coder;
+    t_coder_len len_coder;
+    std::shared_ptr<const model_type> m_model;
+
+    void check_model() const
+    {
+        if (!m_model) {
+            throw std::runtime_error("factor_coder_blocked_twostream_primed: no model. Train one with the store builder.");
+        }
+    }
+
+public:
+    static std::string type()
+    {
+        return "factor_coder_blocked_twostream_primed-t=" + std::to_string(t_literal_threshold)
+            + "-" + t_coder_offset::type() + "-" + t_coder_len::type() + "-p=" + std::to_string(t_prime_size);
+    }
+
+    void use_model(const std::shared_ptr<const model_type>& model)
+    {
+        m_model = model;
+        if (m_model) {
+            len_coder.prime((const uint8_t*)m_model->lengths.data(), m_model->lengths.size());
+            offsetliteral_coder.prime((const uint8_t*)m_model->offset_literals.data(), m_model->offset_literals.size());
+        }
+        else {
+            len_coder.prime(nullptr, 0);
+            offsetliteral_coder.prime(nullptr, 0);
+        }
+    }
+
+    const std::shared_ptr<const model_type>& model() const
+    {
+        return m_model;
+    }
+
+    template <class t_ostream>
+    void encode_block(t_ostream& ofs, block_factor_data& bfd) const
+    {
+        check_model();
+        std::for_each(bfd.lengths.begin(), bfd.lengths.begin() + bfd.num_factors, [](uint32_t& n) { n--; });
+        len_coder.encode(ofs, bfd.lengths.data(), bfd.num_factors);
+        offsetliteral_coder.encode(ofs, bfd.offset_literals.data(), bfd.num_offset_literals);
+    }
+
+    template <class t_istream>
+    coder_size_info decode_block(t_istream& ifs, block_factor_data& bfd, size_t num_factors) const
+    {
+        check_model();
+        coder_size_info csi;
+        auto len_pos = ifs.tellg();
+        bfd.num_factors = num_factors;
+        len_coder.decode(ifs, bfd.lengths.data(), num_factors);
+        csi.length_bytes = (ifs.tellg() - len_pos) / 8;
+        bfd.num_offset_literals = 0;
+        for (size_t i = 0; i < num_factors; i++) {
+            auto len = ++bfd.lengths[i];
+            bfd.num_offset_literals += (len <= literal_threshold) ? len : 1;
+        }
+
+        auto off_pos = ifs.tellg();
+        offsetliteral_coder.decode(ifs, bfd.offset_literals.data(), bfd.num_offset_literals);
+        csi.offset_bytes = (ifs.tellg() - off_pos) / 8;
+        bfd.num_literals = 0;
+        bfd.num_offsets = 0;
+        size_t pos = 0;
+        for (size_t i = 0; i < num_factors; i++) {
+            auto len = bfd.lengths[i];
+            if (len <= literal_threshold) {
+                for (size_t j = 0; j < len; j++)
+                    bfd.literals[bfd.num_literals++] = bfd.offset_literals[pos++];
             }
             else {
-                bfd.offsets[bfd.num_offsets++] = bfd.offset_literals[i];
+                bfd.offsets[bfd.num_offsets++] = bfd.offset_literals[pos++];
+            }
+        }
+        return csi;
+    }
+
+    /* the literals are interleaved with the offsets, so this decodes the whole block */
+    template <class t_istream>
+    void decode_lengths(t_istream& ifs, block_factor_data& bfd, size_t num_factors) const
+    {
+        decode_block(ifs, bfd, num_factors);
+    }
+
+    /* after decode_lengths everything is decoded already */
+    template <class t_istream>
+    void decode_range(t_istream&, block_factor_data&, size_t, size_t, size_t, size_t) const
+    {
+    }
+};
+
+/*
+    the collection-level tables of factor_coder_rans: lengths and offsets
+    as split values (see rans::split), literals as bytes.
+ */
+struct rans_factor_model {
+    using size_type = uint64_t;
+    rans::table lengths;
+    rans::table literals;
+    rans::table offsets;
+    // symbol counts of the blocks seen so far, only used for training
+    std::vector<uint64_t> length_counts = std::vector<uint64_t>(rans::split_symbols);
+    std::vector<uint64_t> literal_counts = std::vector<uint64_t>(256);
+    std::vector<uint64_t> offset_counts = std::vector<uint64_t>(rans::split_symbols);
+
+    void count(const block_factor_data& bfd)
+    {
+        uint32_t raw;
+        for (size_t i = 0; i < bfd.num_factors; i++)
+            length_counts[rans::split(bfd.lengths[i] - 1, raw)]++;
+        for (size_t i = 0; i < bfd.num_literals; i++)
+            literal_counts[bfd.literals[i]]++;
+        for (size_t i = 0; i < bfd.num_offsets; i++)
+            offset_counts[rans::split(bfd.offsets[i], raw)]++;
+    }
+
+    void build()
+    {
+        lengths.build(length_counts);
+        literals.build(literal_counts);
+        offsets.build(offset_counts);
+    }
+
+    size_type serialize(std::ostream& out, sdsl::structure_tree_node* v = NULL, std::string name = "") const
+    {
+        using namespace sdsl;
+        structure_tree_node* child = structure_tree::add_child(v, name, sdsl::util::class_name(*this));
+        size_type written_bytes = 0;
+        written_bytes += lengths.serialize(out, child, "lengths");
+        written_bytes += literals.serialize(out, child, "literals");
+        written_bytes += offsets.serialize(out, child, "offsets");
+        sdsl::structure_tree::add_size(child, written_bytes);
+        return written_bytes;
+    }
+
+    void load(std::istream& in)
+    {
+        lengths.load(in);
+        literals.load(in);
+        offsets.load(in);
+    }
+};
+
+/*
+    encode factors in blocks with t_ways interleaved rANS states and the
+    static tables of a rans_factor_model trained once per collection, so
+    blocks carry no tables. a block is the byte length of the rANS
+    stream, the stream (lengths, then literals, then offsets) and the
+    raw low bits of the large lengths and offsets.
+ */
+template <uint32_t t_literal_threshold = 3, uint32_t t_ways = 4>
+struct factor_coder_rans {
+    static_assert(t_ways > 0 && t_ways <= 32, "unsupported number of rANS states");
+    typedef typename sdsl::int_vector<>::size_type size_type;
+    enum { literal_threshold = t_literal_threshold };
+    enum { fused_decoding = false };
+    enum { two_stream = false };
+    using model_type = rans_factor_model;
+
+private:
+    std::shared_ptr<const model_type> m_model;
+    mutable std::vector<uint8_t> m_bytes;
+
+    const model_type& checked_model() const
+    {
+        if (!m_model) {
+            throw std::runtime_error("factor_coder_rans: no model. Train one with the store builder.");
+        }
+        return *m_model;
+    }
+
+    template <class t_istream, class T>
+    static void decode_split(const rans::table& t, uint32_t* x, const uint8_t*& ptr, t_istream& ifs, T* out, size_t n)
+    {
+        uint32_t raw;
+        size_t i = 0;
+        for (; i + t_ways <= n; i += t_ways) {
+            for (size_t l = 0; l < t_ways; l++) {
+                uint32_t v = rans::unsplit(t.decode(x[l], ptr), raw);
+                out[i + l] = raw ? v | ifs.get_int(raw) : v;
             }
         }
+        for (size_t l = 0; i < n; i++, l++) {
+            uint32_t v = rans::unsplit(t.decode(x[l], ptr), raw);
+            out[i] = raw ? v | ifs.get_int(raw) : v;
+        }
+    }
+
+    static void decode_bytes(const rans::table& t, uint32_t* x, const uint8_t*& ptr, uint8_t* out, size_t n)
+    {
+        size_t i = 0;
+        for (; i + t_ways <= n; i += t_ways) {
+            for (size_t l = 0; l < t_ways; l++)
+                out[i + l] = t.decode(x[l], ptr);
+        }
+        for (size_t l = 0; i < n; i++, l++)
+            out[i] = t.decode(x[l], ptr);
+    }
+
+    template <class t_ostream>
+    static void put_raw(t_ostream& ofs, uint32_t v)
+    {
+        uint32_t raw;
+        rans::split(v, raw);
+        if (raw)
+            ofs.put_int_no_size_check(v & ((1u << raw) - 1), raw);
+    }
+
+public:
+    static std::string type()
+    {
+        return "factor_coder_rans-t=" + std::to_string(t_literal_threshold) + "-w" + std::to_string(t_ways);
+    }
+
+    void use_model(const std::shared_ptr<const model_type>& model)
+    {
+        m_model = model;
+    }
+
+    const std::shared_ptr<const model_type>& model() const
+    {
+        return m_model;
+    }
+
+    template <class t_ostream>
+    void encode_block(t_ostream& ofs, block_factor_data& bfd) const
+    {
+        const auto& model = checked_model();
+        const size_t num_symbols = bfd.num_factors + bfd.num_literals + bfd.num_offsets;
+        m_bytes.resize(2 * num_symbols + 4 * t_ways);
+        uint8_t* end = m_bytes.data() + m_bytes.size();
+        uint8_t* ptr = end;
+        uint32_t x[t_ways];
+        std::fill(x, x + t_ways, rans::lower_bound);
+
+        /* the decoder reads the symbols front to back, so encode them back to front */
+        uint32_t raw;
+        uint64_t raw_bits = 0;
+        for (size_t i = bfd.num_offsets; i-- > 0;) {
+            model.offsets.encode(x[i % t_ways], ptr, rans::split(bfd.offsets[i], raw));
+            raw_bits += raw;
+        }
+        for (size_t i = bfd.num_literals; i-- > 0;)
+            model.literals.encode(x[i % t_ways], ptr, bfd.literals[i]);
+        for (size_t i = bfd.num_factors; i-- > 0;) {
+            model.lengths.encode(x[i % t_ways], ptr, rans::split(bfd.lengths[i] - 1, raw));
+            raw_bits += raw;
+        }
+        for (size_t l = t_ways; l-- > 0;)
+            rans::flush(x[l], ptr);
+
+        uint32_t num_bytes = end - ptr;
+        ofs.expand_if_needed(8 + 32 + num_bytes * 8 + raw_bits);
+        ofs.align8();
+        *(uint32_t*)ofs.cur_data8() = num_bytes;
+        ofs.skip(32);
+        std::memcpy(ofs.cur_data8(), ptr, num_bytes);
+        ofs.skip(num_bytes * 8);
+        for (size_t i = 0; i < bfd.num_factors; i++)
+            put_raw(ofs, bfd.lengths[i] - 1);
+        for (size_t i = 0; i < bfd.num_offsets; i++)
+            put_raw(ofs, bfd.offsets[i]);
+    }
+
+    template <class t_istream>
+    coder_size_info decode_block(t_istream& ifs, block_factor_data& bfd, size_t num_factors) const
+    {
+        const auto& model = checked_model();
+        coder_size_info csi;
+        auto start_pos = ifs.tellg();
+        ifs.align8();
+        uint32_t num_bytes = *(const uint32_t*)ifs.cur_data8();
+        ifs.skip(32);
+        const uint8_t* ptr = ifs.cur_data8();
+        const uint8_t* begin = ptr;
+        ifs.skip(uint64_t(num_bytes) * 8);
+        uint32_t x[t_ways];
+        for (size_t l = 0; l < t_ways; l++)
+            x[l] = rans::init(ptr);
+
+        bfd.num_factors = num_factors;
+        decode_split(model.lengths, x, ptr, ifs, bfd.lengths.data(), num_factors);
+        bfd.num_literals = 0;
+        bfd.num_offsets = 0;
+        for (size_t i = 0; i < num_factors; i++) {
+            auto len = ++bfd.lengths[i];
+            if (len <= literal_threshold)
+                bfd.num_literals += len;
+            else
+                bfd.num_offsets++;
+        }
+        csi.length_bytes = (ptr - begin) + (ifs.tellg() - start_pos - uint64_t(num_bytes) * 8) / 8;
+
+        auto lit_ptr = ptr;
+        decode_bytes(model.literals, x, ptr, bfd.literals.data(), bfd.num_literals);
+        csi.literal_bytes = ptr - lit_ptr;
+
+        auto raw_pos = ifs.tellg();
+        auto off_ptr = ptr;
+        decode_split(model.offsets, x, ptr, ifs, bfd.offsets.data(), bfd.num_offsets);
+        csi.offset_bytes = (ptr - off_ptr) + (ifs.tellg() - raw_pos) / 8;
+        return csi;
+    }
+
+    /* the streams are interleaved, so this decodes the whole block */
+    template <class t_istream>
+    void decode_lengths(t_istream& ifs, block_factor_data& bfd, size_t num_factors) const
+    {
+        decode_block(ifs, bfd, num_factors);
+    }
+
+    /* after decode_lengths everything is decoded already */
+    template <class t_istream>
+    void decode_range(t_istream&, block_factor_data&, size_t, size_t, size_t, size_t) const
+    {
     }
 };
@@ -0,0 +1,135 @@
+#pragma once
+
+#include "utils.hpp"
+#include "collection.hpp"
+
+#include <sdsl/int_vector.hpp>
+#include <string>
+
+/*
+    sampled checkpoints inside each factorized block. every
+    sample_rate factors we store the text position inside the block
+    and the literal and offset cursors at that factor. a range
+    request can start copying at the closest checkpoint instead of
+    rebuilding the block from its first factor.
+ */
+struct factor_skip_index {
+    typedef typename sdsl::int_vector<>::size_type size_type;
+    struct checkpoint {
+        uint64_t factor;
+        uint64_t text_pos;
+        uint64_t literal_pos;
+        uint64_t offset_pos;
+    };
+
+    uint64_t m_sample_rate = 64;
+    sdsl::int_vector<> m_block_checkpoints; // index of the first checkpoint of each block
+    sdsl::int_vector<> m_text_pos;
+    sdsl::int_vector<> m_literal_pos;
+    sdsl::int_vector<> m_offset_pos;
+
+    static std::string type()
+    {
+        return "factor_skip_index";
+    }
+
+    factor_skip_index() = default;
+    factor_skip_index(factor_skip_index&&) = default;
+    factor_skip_index& operator=(factor_skip_index&&) = default;
+
+    template <class t_idx>
+    factor_skip_index(const t_idx& idx, uint64_t sample_rate = 64)
+        : m_sample_rate(sample_rate)
+    {
+        LOG(INFO) << "\tCreate factor skip index (sample rate = " << sample_rate << ")";
+        using coder_type = typename t_idx::factor_coder_type;
+        auto num_blocks = idx.block_map.num_blocks();
+        std::vector<uint64_t> block_checkpoints;
+        std::vector<uint64_t> text_pos, literal_pos, offset_pos;
+        auto ctx = idx.create_context();
+        for (size_t block_id = 0; block_id < num_blocks; block_id++) {
+            block_checkpoints.push_back(text_pos.size());
+            auto num_factors = idx.block_map.block_factors(block_id);
+            idx.seek_block(ctx, block_id);
+            ctx.coder.decode_lengths(ctx.stream, ctx.bfd, num_factors);
+            uint64_t tpos = 0, lpos = 0, opos = 0;
+            for (size_t i = 0; i < num_factors; i++) {
+                if (i % m_sample_rate == 0) {
+                    text_pos.push_back(tpos);
+                    literal_pos.push_back(lpos);
+                    offset_pos.push_back(opos);
+                }
+                auto len = ctx.bfd.lengths[i];
+                if (len <= coder_type::literal_threshold)
+                    lpos += len;
+                else
+                    opos++;
+                tpos += len;
+            }
+        }
+        block_checkpoints.push_back(text_pos.size());
+        m_block_checkpoints = to_int_vector(block_checkpoints);
+        m_text_pos = to_int_vector(text_pos);
+        m_literal_pos = to_int_vector(literal_pos);
+        m_offset_pos = to_int_vector(offset_pos);
+    }
+
+    inline size_type serialize(std::ostream& out, sdsl::structure_tree_node* v = NULL, std::string name = "") const
+    {
+        using namespace sdsl;
+        structure_tree_node* child = structure_tree::add_child(v, name, sdsl::util::class_name(*this));
+        size_type written_bytes = 0;
+        written_bytes += sdsl::write_member(m_sample_rate, out, child, "sample_rate");
+        written_bytes += m_block_checkpoints.serialize(out, child, "block_checkpoints");
+        written_bytes += m_text_pos.serialize(out, child, "text_pos");
+        written_bytes += m_literal_pos.serialize(out, child, "literal_pos");
+        written_bytes += m_offset_pos.serialize(out, child, "offset_pos");
+        sdsl::structure_tree::add_size(child, written_bytes);
+        return written_bytes;
+    }
+
+    inline void load(std::istream& in)
+    {
+        sdsl::read_member(m_sample_rate, in);
+        m_block_checkpoints.load(in);
+        m_text_pos.load(in);
+        m_literal_pos.load(in);
+        m_offset_pos.load(in);
+    }
+
+    size_type size_in_bytes() const
+    {
+        return sdsl::size_in_bytes(*this);
+    }
+
+    bool empty() const
+    {
+        return m_block_checkpoints.size() == 0;
+    }
+
+    /* last checkpoint of the block at or before the in-block text position */
+    checkpoint find(size_t block_id, uint64_t text_pos) const
+    {
+        size_t lb = m_block_checkpoints[block_id];
+        size_t rb = m_block_checkpoints[block_id + 1];
+        while (rb - lb > 1) {
+            size_t mid = lb + (rb - lb) / 2;
+            if (m_text_pos[mid] <= text_pos)
+                lb = mid;
+            else
+                rb = mid;
+        }
+        auto first = m_block_checkpoints[block_id];
+        return checkpoint{ (lb - first) * m_sample_rate, m_text_pos[lb], m_literal_pos[lb], m_offset_pos[lb] };
+    }
+
+private:
+    static sdsl::int_vector<> to_int_vector(const std::vector<uint64_t>& v)
+    {
+        sdsl::int_vector<> iv(v.size());
+        for (size_t i = 0; i < v.size(); i++)
+            iv[i] = v[i];
+        sdsl::util::bit_compress(iv);
+        return iv;
+    }
+};
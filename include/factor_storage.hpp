@@ -53,7 +53,7 @@ struct factor_tracker {
     hrclock::time_point encoding_start;
     block_factor_data tmp_block_factor_data;
     size_t toffset;
-    factor_tracker(collection& col, size_t _block_size, size_t _offset)
+    factor_tracker(collection& col, size_t _block_size, size_t _offset, factor_layout layout = { 0, true })
         : toffset(_offset)
     {
         {
@@ -64,7 +64,7 @@ struct factor_tracker {
             fs.block_size = _block_size;
         }
         // create a buffer we can write to without reallocating
-        tmp_block_factor_data.resize(_block_size);
+        tmp_block_factor_data.resize(_block_size, layout);
         // save the start of the encoding process
         encoding_start = hrclock::now();
     }
@@ -136,6 +136,35 @@ merge_factor_encodings(collection&, std::vector<factorization_statistics>& efs)
     return fs;
 }
 
+/* feeds the factors of sampled blocks to a coder model (see coder_model) instead of encoding them */
+template <class t_model>
+struct factor_model_sampler {
+    t_model& model;
+    uint64_t sampled_blocks = 0;
+    block_factor_data tmp_block_factor_data;
+    factor_model_sampler(t_model& m, size_t _block_size, factor_layout layout = { 0, true })
+        : model(m)
+    {
+        tmp_block_factor_data.resize(_block_size, layout);
+    }
+    template <class t_coder, class t_itr>
+    void add_to_block_factor(t_coder& coder, t_itr text_itr, uint32_t offset, uint32_t len)
+    {
+        tmp_block_factor_data.add_factor(coder, text_itr, offset, len);
+    }
+    void start_new_block()
+    {
+        tmp_block_factor_data.reset();
+    }
+    template <class t_coder>
+    void encode_current_block(t_coder&)
+    {
+        model.count(tmp_block_factor_data);
+        sampled_blocks++;
+        tmp_block_factor_data.reset();
+    }
+};
+
 struct factor_storage {
     using result_type = factorization_info;
     uint64_t toffset;
@@ -151,7 +180,7 @@ struct factor_storage {
     sdsl::int_vector_mapper<0> block_offsets;
     sdsl::int_vector_mapper<0> block_factors;
     bit_ostream<sdsl::int_vector_mapper<1> > factor_stream;
-    factor_storage(collection& col, size_t _block_size, size_t _offset)
+    factor_storage(collection& col, size_t _block_size, size_t _offset, factor_layout layout = { 0, true })
         : toffset(_offset)
         , block_size(_block_size)
         , factored_text(sdsl::write_out_buffer<1>::create(col.temp_file_name(KEY_FACTORIZED_TEXT, toffset)))
@@ -160,7 +189,7 @@ struct factor_storage {
         , factor_stream(factored_text)
     {
         // create a buffer we can write to without reallocating
-        tmp_block_factor_data.resize(block_size);
+        tmp_block_factor_data.resize(block_size, layout);
         // save the start of the encoding process
         encoding_start = hrclock::now();
         last_stat_output = hrclock::now();
@@ -19,6 +19,8 @@ template <uint32_t t_block_size,
           class t_factor_selector,
           class t_coder>
 struct factorizor {
+    static const uint64_t model_sample_bytes = 64 * 1024 * 1024; // text used to train a coder model
+
     static std::string type()
     {
         return "factorizor-" + std::to_string(t_block_size) + "-l" + std::to_string(t_search_local_block_context) + "-" + t_factor_selector::type() + "-" + t_coder::type();
@@ -45,7 +47,6 @@ struct factorizor {
     template <class t_factor_store, class t_itr>
     static void factorize_block(t_factor_store& fs, t_coder& coder, const t_index& idx, t_itr itr, t_itr end,std::unordered_map<uint64_t,utils::qgram_postings>& )
     {
-        uint64_t encoding_block_size = std::distance(itr,end);
         auto factor_itr = idx. template factorize<t_itr,t_search_local_block_context>(itr, end);
         fs.start_new_block();
         size_t syms_encoded = 0;
@@ -58,7 +59,7 @@ struct factorizor {
                 uint64_t offset = 0;
                 {
                     // auto t = lm_bench::bench(timer_type::PickOffset);
-                    offset = t_factor_selector::template pick_offset<>(idx, factor_itr,t_search_local_block_context,encoding_block_size);
+                    offset = t_factor_selector::template pick_offset<>(idx, factor_itr,t_search_local_block_context,t_block_size);
                 }
                 fs.add_to_block_factor(coder, itr + syms_encoded, offset, factor_itr.len);
                 syms_encoded += factor_itr.len;
@@ -87,10 +88,12 @@ struct factorizor {
         std::unordered_map<uint64_t,utils::qgram_postings> qgc;
 
         /* (1) create output files */
-        t_factor_store fs(col, t_block_size, offset);
+        t_factor_store fs(col, t_block_size, offset, factor_layout::of<t_coder>());
 
         /* (2) create encoder  */
         t_coder coder;
+        if (coder_model<t_coder>::required)
+            coder_model<t_coder>::use(coder, coder_model<t_coder>::load(col.file_map[KEY_FCODER]));
 
         /* (3) compute text stats */
         auto block_size = t_block_size;
@@ -128,12 +131,46 @@ struct factorizor {
                + col.param_map[PARAM_DICT_HASH] + ".sdsl";
     }
 
+    /*
+        trains the collection-level model of the coder (see coder_model)
+        on evenly spaced blocks covering up to model_sample_bytes of text
+        and registers it as KEY_FCODER. coders without a model skip this.
+     */
+    static void create_coder_model(collection& col, const t_index& idx, bool rebuild)
+    {
+        if (!coder_model<t_coder>::required)
+            return;
+        auto model_file = factorcoder_file_name(col);
+        if (rebuild || !utils::file_exists(model_file)) {
+            LOG(INFO) << "Train factor coder model (" << t_coder::type() << ")";
+            const sdsl::int_vector_mapped_buffer<8> text(col.file_map[KEY_TEXT]);
+            auto num_blocks = (text.size() + t_block_size - 1) / t_block_size;
+            auto sample_blocks = std::max<uint64_t>(1, model_sample_bytes / t_block_size);
+            auto step = std::max<uint64_t>(1, num_blocks / sample_blocks);
+            typename coder_model<t_coder>::type model;
+            factor_model_sampler<typename coder_model<t_coder>::type> sampler(model, t_block_size,
+                factor_layout::of<t_coder>());
+            t_coder coder;
+            std::unordered_map<uint64_t, utils::qgram_postings> qgc;
+            for (uint64_t block = 0; block < num_blocks; block += step) {
+                auto itr = text.begin() + block * t_block_size;
+                auto end = text.begin() + std::min<uint64_t>((block + 1) * t_block_size, text.size());
+                factorize_block(sampler, coder, idx, itr, end, qgc);
+            }
+            LOG(INFO) << "Sampled " << sampler.sampled_blocks << " of " << num_blocks << " blocks";
+            model.build();
+            sdsl::store_to_file(model, model_file);
+        }
+        col.file_map[KEY_FCODER] = model_file;
+    }
+
     template <class t_factor_store>
     static typename t_factor_store::result_type
     parallel_factorize(collection& col, bool rebuild, uint32_t num_threads)
     {
         LOG(INFO) << "Create/Load dictionary index";
         t_index idx(col, rebuild);
+        create_coder_model(col, idx, rebuild);
         std::vector<typename t_factor_store::result_type> efs;
         {
             auto text_size = 0ULL;
@@ -0,0 +1,198 @@
+#pragma once
+
+#include "numa.hpp"
+
+#include <sys/mman.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <utility>
+
+/*
+    helpers to back hot read-only structures with 2 MiB pages. random
+    factor copies touch the whole dictionary, so with 4 KiB pages most
+    of them miss the TLB. huge_pages::buffer first tries a hugetlbfs
+    mapping (needs reserved pages, vm.nr_hugepages) and falls back to a
+    2 MiB aligned anonymous mapping advised for transparent huge pages.
+    whether the kernel actually used huge pages is read back from
+    /proc/self/smaps.
+ */
+namespace huge_pages {
+
+const size_t page_size = 2 * 1024 * 1024;
+
+inline size_t round_up(size_t x)
+{
+    return (x + page_size - 1) & ~(page_size - 1);
+}
+
+/* pin the pages of [ptr,ptr+len). fails if RLIMIT_MEMLOCK is too low */
+inline bool lock(const void* ptr, size_t len)
+{
+    if (len == 0)
+        return false;
+    return mlock(ptr, len) == 0;
+}
+
+/* bytes of [ptr,ptr+len) backed by huge pages according to /proc/self/smaps */
+inline size_t backed_bytes(const void* ptr, size_t len)
+{
+    std::ifstream smaps("/proc/self/smaps");
+    if (!smaps || len == 0)
+        return 0;
+    const uintptr_t beg = (uintptr_t)ptr;
+    const uintptr_t end = beg + len;
+    size_t overlap = 0;
+    size_t huge_bytes = 0;
+    std::string line;
+    while (std::getline(smaps, line)) {
+        auto dash = line.find('-');
+        auto space = line.find(' ');
+        if (dash != std::string::npos && space != std::string::npos && dash < space
+            && line.find(':') > space) {
+            /* a new mapping "start-end perms ..." */
+            uintptr_t map_beg = std::stoull(line.substr(0, dash), nullptr, 16);
+            uintptr_t map_end = std::stoull(line.substr(dash + 1, space - dash - 1), nullptr, 16);
+            overlap = 0;
+            if (map_beg < end && beg < map_end) {
+                overlap = std::min(end, map_end) - std::max(beg, map_beg);
+            }
+            continue;
+        }
+        if (overlap == 0)
+            continue;
+        if (line.compare(0, 14, "AnonHugePages:") == 0 || line.compare(0, 16, "Private_Hugetlb:") == 0
+            || line.compare(0, 15, "Shared_Hugetlb:") == 0) {
+            std::istringstream iss(line.substr(line.find(':') + 1));
+            size_t kb = 0;
+            iss >> kb;
+            huge_bytes += std::min(kb * 1024, overlap);
+        }
+    }
+    return huge_bytes;
+}
+
+/* a read-only copy of some bytes in a mapping of its own, on huge pages unless asked otherwise */
+class buffer {
+private:
+    uint8_t* m_data = nullptr;
+    size_t m_size = 0;
+    size_t m_mapped = 0;
+    bool m_hugetlb = false;
+    bool m_locked = false;
+
+    void release()
+    {
+        if (m_data) {
+            if (m_locked)
+                munlock(m_data, m_mapped);
+            munmap(m_data, m_mapped);
+        }
+        m_data = nullptr;
+        m_size = m_mapped = 0;
+        m_hugetlb = m_locked = false;
+    }
+
+public:
+    buffer() = default;
+    buffer(const buffer&) = delete;
+    buffer& operator=(const buffer&) = delete;
+    buffer(buffer&& other)
+    {
+        *this = std::move(other);
+    }
+    buffer& operator=(buffer&& other)
+    {
+        if (this != &other) {
+            release();
+            std::swap(m_data, other.m_data);
+            std::swap(m_size, other.m_size);
+            std::swap(m_mapped, other.m_mapped);
+            std::swap(m_hugetlb, other.m_hugetlb);
+            std::swap(m_locked, other.m_locked);
+        }
+        return *this;
+    }
+    ~buffer()
+    {
+        release();
+    }
+
+    /*
+        returns false if no mapping could be created at all. without huge
+        pages the copy uses regular pages. a numa_node >= 0 places the
+        pages on that node before they are first touched.
+     */
+    bool assign(const uint8_t* src, size_t size, bool lock_pages, bool huge = true, int numa_node = -1)
+    {
+        release();
+        if (size == 0)
+            return false;
+        void* ptr = MAP_FAILED;
+        if (!huge) {
+            m_mapped = (size + 4095) & ~size_t(4095);
+            ptr = mmap(nullptr, m_mapped, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        }
+        else {
+            m_mapped = round_up(size);
+#ifdef MAP_HUGETLB
+            ptr = mmap(nullptr, m_mapped, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+            m_hugetlb = (ptr != MAP_FAILED);
+#endif
+            if (ptr == MAP_FAILED) {
+                /* over-allocate so the buffer can start on a 2 MiB boundary */
+                size_t len = m_mapped + page_size;
+                ptr = mmap(nullptr, len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+                if (ptr != MAP_FAILED) {
+                    auto aligned = round_up((uintptr_t)ptr);
+                    auto head = aligned - (uintptr_t)ptr;
+                    if (head)
+                        munmap(ptr, head);
+                    if (len - head > m_mapped)
+                        munmap((void*)(aligned + m_mapped), len - head - m_mapped);
+                    ptr = (void*)aligned;
+                    madvise(ptr, m_mapped, MADV_HUGEPAGE);
+                }
+            }
+        }
+        if (ptr == MAP_FAILED) {
+            m_mapped = 0;
+            return false;
+        }
+        m_data = (uint8_t*)ptr;
+        m_size = size;
+        if (numa_node >= 0)
+            numa::bind(m_data, m_mapped, numa_node);
+        memcpy(m_data, src, size);
+        mprotect(m_data, m_mapped, PROT_READ);
+        if (lock_pages)
+            m_locked = lock(m_data, m_mapped);
+        return true;
+    }
+
+    const uint8_t* data() const
+    {
+        return m_data;
+    }
+    size_t size() const
+    {
+        return m_size;
+    }
+    bool empty() const
+    {
+        return m_data == nullptr;
+    }
+    bool hugetlb() const
+    {
+        return m_hugetlb;
+    }
+    bool locked() const
+    {
+        return m_locked;
+    }
+};
+}
@@ -0,0 +1,212 @@
+#pragma once
+
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#if defined(__NR_io_uring_setup) && defined(__NR_io_uring_enter)
+#include <linux/io_uring.h>
+#define RLZ_HAVE_IO_URING 1
+#endif
+
+/*
+    a minimal io_uring submission/completion ring for positioned reads,
+    driven through the raw syscalls so there is no dependency on
+    liburing. one thread submits many reads and reaps them in the order
+    they complete, which keeps the queue depth of an SSD high without a
+    thread per outstanding read. if the kernel (or a seccomp policy)
+    does not allow io_uring, ok() is false and callers fall back to pread.
+ */
+class io_ring {
+private:
+    int m_fd = -1;
+    unsigned m_inflight = 0;
+    unsigned m_queued = 0; // prepared but not yet submitted
+#ifdef RLZ_HAVE_IO_URING
+    io_uring_params m_params;
+    void* m_sq_ring = MAP_FAILED;
+    size_t m_sq_ring_len = 0;
+    void* m_cq_ring = MAP_FAILED;
+    size_t m_cq_ring_len = 0;
+    io_uring_sqe* m_sqes = (io_uring_sqe*)MAP_FAILED;
+    size_t m_sqes_len = 0;
+    unsigned* m_sq_head = nullptr;
+    unsigned* m_sq_tail = nullptr;
+    unsigned* m_sq_mask = nullptr;
+    unsigned* m_sq_array = nullptr;
+    unsigned* m_cq_head = nullptr;
+    unsigned* m_cq_tail = nullptr;
+    unsigned* m_cq_mask = nullptr;
+    io_uring_cqe* m_cqes = nullptr;
+    std::vector<iovec> m_iovecs; // one per sqe, must live until the read completes
+
+    static uint8_t* at(void* ring, uint32_t offset)
+    {
+        return (uint8_t*)ring + offset;
+    }
+
+    int enter(unsigned to_submit, unsigned min_complete, unsigned flags)
+    {
+        return syscall(__NR_io_uring_enter, m_fd, to_submit, min_complete, flags, nullptr, 0);
+    }
+
+    void release()
+    {
+        if (m_sqes != MAP_FAILED)
+            munmap(m_sqes, m_sqes_len);
+        if (m_cq_ring != MAP_FAILED)
+            munmap(m_cq_ring, m_cq_ring_len);
+        if (m_sq_ring != MAP_FAILED)
+            munmap(m_sq_ring, m_sq_ring_len);
+        if (m_fd >= 0)
+            close(m_fd);
+        m_fd = -1;
+    }
+#endif
+
+public:
+    explicit io_ring(unsigned entries)
+    {
+#ifdef RLZ_HAVE_IO_URING
+        memset(&m_params, 0, sizeof(m_params));
+        m_fd = syscall(__NR_io_uring_setup, entries, &m_params);
+        if (m_fd < 0) {
+            m_fd = -1;
+            return;
+        }
+        m_sq_ring_len = m_params.sq_off.array + m_params.sq_entries * sizeof(unsigned);
+        m_cq_ring_len = m_params.cq_off.cqes + m_params.cq_entries * sizeof(io_uring_cqe);
+        m_sqes_len = m_params.sq_entries * sizeof(io_uring_sqe);
+        m_sq_ring = mmap(nullptr, m_sq_ring_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, m_fd, IORING_OFF_SQ_RING);
+        m_cq_ring = mmap(nullptr, m_cq_ring_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, m_fd, IORING_OFF_CQ_RING);
+        m_sqes = (io_uring_sqe*)mmap(nullptr, m_sqes_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, m_fd, IORING_OFF_SQES);
+        if (m_sq_ring == MAP_FAILED || m_cq_ring == MAP_FAILED || m_sqes == MAP_FAILED) {
+            release();
+            return;
+        }
+        m_sq_head = (unsigned*)at(m_sq_ring, m_params.sq_off.head);
+        m_sq_tail = (unsigned*)at(m_sq_ring, m_params.sq_off.tail);
+        m_sq_mask = (unsigned*)at(m_sq_ring, m_params.sq_off.ring_mask);
+        m_sq_array = (unsigned*)at(m_sq_ring, m_params.sq_off.array);
+        m_cq_head = (unsigned*)at(m_cq_ring, m_params.cq_off.head);
+        m_cq_tail = (unsigned*)at(m_cq_ring, m_params.cq_off.tail);
+        m_cq_mask = (unsigned*)at(m_cq_ring, m_params.cq_off.ring_mask);
+        m_cqes = (io_uring_cqe*)at(m_cq_ring, m_params.cq_off.cqes);
+        m_iovecs.resize(m_params.sq_entries);
+#else
+        (void)entries;
+#endif
+    }
+
+    io_ring(const io_ring&) = delete;
+    io_ring& operator=(const io_ring&) = delete;
+
+    /* the buffers of outstanding reads are owned by the caller, so wait for them */
+    ~io_ring()
+    {
+#ifdef RLZ_HAVE_IO_URING
+        uint64_t user_data;
+        int res;
+        try {
+            while (m_inflight && wait(user_data, res)) {
+            }
+        }
+        catch (...) {
+        }
+        release();
+#endif
+    }
+
+    bool ok() const
+    {
+        return m_fd >= 0;
+    }
+
+    /* reads submitted and not yet reaped */
+    unsigned inflight() const
+    {
+        return m_inflight;
+    }
+
+    /* queues a read of len bytes at offset into buf. false if the ring is full */
+    bool read(int fd, void* buf, size_t len, uint64_t offset, uint64_t user_data)
+    {
+#ifdef RLZ_HAVE_IO_URING
+        if (!ok() || m_inflight + m_queued >= m_params.sq_entries)
+            return false;
+        unsigned tail = *m_sq_tail;
+        unsigned idx = tail & *m_sq_mask;
+        io_uring_sqe* sqe = &m_sqes[idx];
+        memset(sqe, 0, sizeof(*sqe));
+        m_iovecs[idx].iov_base = buf;
+        m_iovecs[idx].iov_len = len;
+        sqe->opcode = IORING_OP_READV;
+        sqe->fd = fd;
+        sqe->off = offset;
+        sqe->addr = (uint64_t)(uintptr_t)&m_iovecs[idx];
+        sqe->len = 1;
+        sqe->user_data = user_data;
+        m_sq_array[idx] = idx;
+        __atomic_store_n(m_sq_tail, tail + 1, __ATOMIC_RELEASE);
+        m_queued++;
+        return true;
+#else
+        (void)fd, (void)buf, (void)len, (void)offset, (void)user_data;
+        return false;
+#endif
+    }
+
+    /* hands the queued reads to the kernel */
+    void submit()
+    {
+#ifdef RLZ_HAVE_IO_URING
+        while (m_queued) {
+            int ret = enter(m_queued, 0, 0);
+            if (ret < 0) {
+                if (errno == EINTR || errno == EAGAIN)
+                    continue;
+                throw std::runtime_error("io_ring: submit failed: " + std::string(strerror(errno)));
+            }
+            m_queued -= ret;
+            m_inflight += ret;
+        }
+#endif
+    }
+
+    /*
+        blocks until a read completes. res is the number of bytes read or
+        -errno. returns false if nothing is outstanding.
+     */
+    bool wait(uint64_t& user_data, int& res)
+    {
+#ifdef RLZ_HAVE_IO_URING
+        if (m_inflight == 0)
+            return false;
+        for (;;) {
+            unsigned head = *m_cq_head;
+            if (head != __atomic_load_n(m_cq_tail, __ATOMIC_ACQUIRE)) {
+                const io_uring_cqe& cqe = m_cqes[head & *m_cq_mask];
+                user_data = cqe.user_data;
+                res = cqe.res;
+                __atomic_store_n(m_cq_head, head + 1, __ATOMIC_RELEASE);
+                m_inflight--;
+                return true;
+            }
+            if (enter(0, 1, IORING_ENTER_GETEVENTS) < 0 && errno != EINTR) {
+                throw std::runtime_error("io_ring: wait failed: " + std::string(strerror(errno)));
+            }
+        }
+#else
+        (void)user_data, (void)res;
+        return false;
+#endif
+    }
+};
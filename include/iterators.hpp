@@ -2,6 +2,10 @@
 
 #include "factor_data.hpp"
 
+#include <cstring>
+#include <limits>
+#include <type_traits>
+
 struct factor_data {
     bool is_literal;
     uint8_t* literal_ptr;
@@ -14,6 +18,7 @@ class factor_iterator {
 public:
     using size_type = uint64_t;
     using value_type = factor_data;
+    using context_type = typename std::decay<t_idx>::type::context_type;
 
 private:
     t_idx& m_idx;
@@ -22,7 +27,7 @@ private:
     size_t m_factors_in_cur_block;
     size_t m_in_block_literals_offset;
     size_t m_in_block_offsets_offset;
-    block_factor_data m_block_factor_data;
+    context_type m_ctx;
     std::vector<uint32_t> m_offset_buf;
     std::vector<uint32_t> m_len_buf;
 
@@ -35,8 +40,8 @@ public:
         : m_idx(idx)
         , m_block_offset(block_offset)
         , m_factor_offset(factor_offset)
+        , m_ctx(m_idx.create_context())
     {
-        m_block_factor_data.resize(m_idx.encoding_block_size);
         decode_cur_block();
     }
     void decode_cur_block()
@@ -44,7 +49,7 @@ public:
         if (m_block_offset < m_idx.block_map.num_blocks()) {
             m_factors_in_cur_block = m_idx.block_map.block_factors(m_block_offset);
             auto block_file_offset = m_idx.block_map.block_offset(m_block_offset);
-            cur_block_size_info = m_idx.decode_factors(block_file_offset, m_block_factor_data, m_factors_in_cur_block);
+            cur_block_size_info = m_idx.decode_factors(m_ctx, block_file_offset, m_factors_in_cur_block);
             m_in_block_literals_offset = 0;
             m_in_block_offsets_offset = 0;
         }
@@ -55,16 +60,16 @@ public:
             decode_cur_block();
         }
         factor_data fd;
-        fd.len = m_block_factor_data.lengths[m_factor_offset];
-        if (m_block_factor_data.lengths[m_factor_offset] <= m_idx.m_factor_coder.literal_threshold) {
+        fd.len = m_ctx.bfd.lengths[m_factor_offset];
+        if (m_ctx.bfd.lengths[m_factor_offset] <= context_type::coder_type::literal_threshold) {
             /* literal factor */
             fd.is_literal = true;
-            fd.literal_ptr = m_block_factor_data.literals.data() + m_in_block_literals_offset;
+            fd.literal_ptr = m_ctx.bfd.literals.data() + m_in_block_literals_offset;
             m_in_block_literals_offset += fd.len;
         }
         else {
             fd.is_literal = false;
-            fd.offset = m_block_factor_data.offsets[m_in_block_offsets_offset];
+            fd.offset = m_ctx.bfd.offsets[m_in_block_offsets_offset];
             m_in_block_offsets_offset++;
         }
         return fd;
@@ -90,10 +95,17 @@ public:
     }
 };
 
+/* contiguous view into the decoded block of a text_iterator */
+struct text_span {
+    const uint8_t* data;
+    size_t size;
+};
+
 template <class t_idx>
 class text_iterator {
 public:
     using size_type = uint64_t;
+    using context_type = typename std::decay<t_idx>::type::context_type;
 
 private:
     t_idx& m_idx;
@@ -101,7 +113,8 @@ private:
     size_t m_text_block_offset;
     size_t m_block_size;
     size_t m_block_offset;
-    block_factor_data m_block_factor_data;
+    size_t m_decoded_block;
+    context_type m_ctx;
     std::vector<uint8_t> m_text_buf;
 
 public:
@@ -115,17 +128,19 @@ public:
         , m_text_block_offset(text_offset % m_idx.encoding_block_size)
         , m_block_size(m_idx.encoding_block_size)
         , m_block_offset(text_offset / m_idx.encoding_block_size)
+        , m_decoded_block(std::numeric_limits<size_t>::max())
+        , m_ctx(m_idx.create_context())
     {
-        m_block_factor_data.resize(m_block_size);
         m_text_buf.resize(m_block_size);
     }
     inline void decode_cur_block()
     {
-        m_block_size = m_idx.decode_block(m_block_offset, m_text_buf, m_block_factor_data);
+        m_block_size = m_idx.decode_block(m_ctx, m_block_offset, m_text_buf);
+        m_decoded_block = m_block_offset;
     }
     inline uint8_t operator*()
     {
-        if (m_text_block_offset == 0) {
+        if (m_decoded_block != m_block_offset) {
             decode_cur_block();
         }
         return m_text_buf[m_text_block_offset];
@@ -153,84 +168,53 @@ public:
 
     void seek(size_type new_text_offset)
     {
-        auto new_block_offset = new_text_offset / m_block_size;
-        m_text_block_offset = new_text_offset % m_block_size;
-        if (new_block_offset != m_block_offset) {
-            m_block_offset = new_block_offset;
-            if (m_text_block_offset != 0)
-                decode_cur_block();
-        }
+        m_text_offset = new_text_offset;
+        m_block_offset = new_text_offset / m_idx.encoding_block_size;
+        m_text_block_offset = new_text_offset % m_idx.encoding_block_size;
+        if (m_decoded_block != m_block_offset)
+            m_block_size = m_idx.encoding_block_size;
     }
-};
-
-template <class t_idx>
-class zlib_text_iterator {
-public:
-    using size_type = uint64_t;
-
-private:
-    t_idx& m_idx;
-    size_t m_text_offset;
-    size_t m_text_block_offset;
-    size_t m_block_size;
-    size_t m_block_offset;
-    std::vector<uint8_t> m_text_buf;
-    block_factor_data m_block_factor_data;
-
-public:
-    const size_t& block_id = m_block_offset;
-    const size_t& block_size = m_block_size;
 
-public:
-    zlib_text_iterator(t_idx& idx, size_t text_offset)
-        : m_idx(idx)
-        , m_text_offset(text_offset)
-        , m_text_block_offset(text_offset % m_idx.encoding_block_size)
-        , m_block_size(m_idx.encoding_block_size)
-        , m_block_offset(text_offset / m_idx.encoding_block_size)
+    /* returns the rest of the current block and moves to the next one.
+       an empty span signals the end of the text */
+    text_span next_span()
     {
-        m_text_buf.resize(m_block_size);
-    }
-    inline void decode_cur_block()
-    {
-        m_block_size = m_idx.decode_block(m_block_offset, m_text_buf, m_block_factor_data);
-    }
-    inline uint8_t operator*()
-    {
-        if (m_text_block_offset == 0) {
+        if (m_text_offset >= m_idx.size())
+            return text_span{ nullptr, 0 };
+        if (m_decoded_block != m_block_offset) {
             decode_cur_block();
         }
-        return m_text_buf[m_text_block_offset];
-    }
-    inline bool operator==(const zlib_text_iterator& b) const
-    {
-        return m_text_offset == b.m_text_offset;
-    }
-    inline bool operator!=(const zlib_text_iterator& b) const
-    {
-        return m_text_offset != b.m_text_offset;
-    }
-    inline zlib_text_iterator& operator++()
-    {
-        if (m_text_block_offset + 1 == m_block_size) {
-            m_text_block_offset = 0;
-            m_block_offset++;
-        }
-        else {
-            m_text_block_offset++;
-        }
-        m_text_offset++;
-        return *this;
+        text_span span{ m_text_buf.data() + m_text_block_offset, m_block_size - m_text_block_offset };
+        m_text_offset += span.size;
+        m_text_block_offset = 0;
+        m_block_offset++;
+        return span;
     }
 
-    void seek(size_type new_text_offset)
+    /* copies up to n symbols to dst and advances the iterator. returns
+       the number of symbols copied, which is less than n at the end of the text */
+    size_t read(uint8_t* dst, size_t n)
     {
-        auto new_block_offset = new_text_offset / m_block_size;
-        m_text_block_offset = new_text_offset % m_block_size;
-        if (new_block_offset != m_block_offset) {
-            m_block_offset = new_block_offset;
-            if (m_text_block_offset != 0)
+        n = std::min<size_t>(n, m_idx.size() - std::min<size_t>(m_text_offset, m_idx.size()));
+        size_t copied = 0;
+        while (copied != n) {
+            if (m_decoded_block != m_block_offset) {
                 decode_cur_block();
+            }
+            size_t k = std::min(n - copied, m_block_size - m_text_block_offset);
+            std::memcpy(dst + copied, m_text_buf.data() + m_text_block_offset, k);
+            copied += k;
+            m_text_offset += k;
+            m_text_block_offset += k;
+            if (m_text_block_offset == m_block_size) {
+                m_text_block_offset = 0;
+                m_block_offset++;
+            }
         }
+        return copied;
     }
 };
+
+/* the lz stores expose the same context interface */
+template <class t_idx>
+using zlib_text_iterator = text_iterator<t_idx>;
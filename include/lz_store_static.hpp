@@ -4,6 +4,12 @@
 #include "collection.hpp"
 
 #include "iterators.hpp"
+#include "decode_context.hpp"
+#include "block_cache.hpp"
+#include "batch_extract.hpp"
+#include "page_advice.hpp"
+#include "docno_index.hpp"
+#include "store_manifest.hpp"
 #include "block_maps.hpp"
 #include "factor_selector.hpp"
 #include "factorizor.hpp"
@@ -21,20 +27,21 @@ public:
     using coder_type = t_coder;
     using block_map_type = block_map_uncompressed;
     using size_type = uint64_t;
+    using context_type = decode_context<coder_type>;
 
 private:
     sdsl::int_vector_mapper<1, std::ios_base::in> m_compressed_text;
-    bit_istream<sdsl::int_vector_mapper<1, std::ios_base::in> > m_compressed_stream;
     block_map_type m_blockmap;
+    docno_index m_docno_index;
+    std::unique_ptr<block_cache> m_block_cache;
+    uint64_t m_store_id = next_store_id();
 
 public:
     enum { block_size = t_block_size };
     uint64_t encoding_block_size = block_size;
     block_map_type& block_map = m_blockmap;
-    coder_type coder;
     sdsl::int_vector_mapper<1, std::ios_base::in>& compressed_text = m_compressed_text;
     uint64_t text_size;
-    mutable block_factor_data dummy;
 
 public:
     class builder;
@@ -45,24 +52,66 @@ public:
     }
 
     lz_store_static() = delete;
-    lz_store_static(lz_store_static&&) = default;
-    lz_store_static& operator=(lz_store_static&&) = default;
+
+    /* a moved store takes a fresh id, as contexts cached for the old one point into the moved-from store */
+    lz_store_static(lz_store_static&& other)
+        : m_compressed_text(std::move(other.m_compressed_text))
+        , m_blockmap(std::move(other.m_blockmap))
+        , m_docno_index(std::move(other.m_docno_index))
+        , m_block_cache(std::move(other.m_block_cache))
+        , encoding_block_size(other.encoding_block_size)
+        , text_size(other.text_size)
+    {
+        other.m_store_id = next_store_id();
+    }
+
+    lz_store_static& operator=(lz_store_static&& other)
+    {
+        if (this != &other) {
+            m_compressed_text = std::move(other.m_compressed_text);
+            m_blockmap = std::move(other.m_blockmap);
+            m_docno_index = std::move(other.m_docno_index);
+            m_block_cache = std::move(other.m_block_cache);
+            encoding_block_size = other.encoding_block_size;
+            text_size = other.text_size;
+            m_store_id = next_store_id();
+            other.m_store_id = next_store_id();
+        }
+        return *this;
+    }
+
     lz_store_static(collection& col)
-        : m_compressed_text(col.file_map[KEY_LZ])
-        , m_compressed_stream(m_compressed_text) // (1) mmap factored text
+        : m_compressed_text(col.file_map[KEY_LZ]) // (1) mmap factored text
     {
         LOG(INFO) << "Loading Zlib store into memory (" << type() << ")";
         // (2) load the block map
         LOG(INFO) << "\tLoad block map";
         sdsl::load_from_file(m_blockmap, col.file_map[KEY_BLOCKMAP]);
-        {
-            LOG(INFO) << "\tDetermine text size";
-            const sdsl::int_vector_mapper<8, std::ios_base::in> text(col.file_map[KEY_TEXT]);
-            text_size = text.size();
+        if (col.file_map.count(KEY_DOCNOINDEX)) {
+            LOG(INFO) << "\tLoad docno index";
+            sdsl::load_from_file(m_docno_index, col.file_map[KEY_DOCNOINDEX]);
         }
+        text_size = col.text_size();
         LOG(INFO) << "Zlib store ready (" << type() << ")";
     }
 
+    /* identifies the instance for per-thread scratch, see scratch_contexts */
+    uint64_t store_id() const
+    {
+        return m_store_id;
+    }
+
+    /* number of text bytes in the block */
+    uint64_t block_length(uint64_t block_id) const
+    {
+        return std::min<uint64_t>(block_size, text_size - block_id * block_size);
+    }
+
+    context_type create_context() const
+    {
+        return context_type(m_compressed_text, 0);
+    }
+
     auto begin() const -> zlib_text_iterator<decltype(*this)>
     {
         return zlib_text_iterator<decltype(*this)>(*this, 0);
@@ -83,29 +132,130 @@ public:
         return (m_compressed_text.size() >> 3) + m_blockmap.size_in_bytes();
     }
 
-    inline uint64_t decode_block(uint64_t block_id, std::vector<uint8_t>& text, block_factor_data&) const
+    /* read-ahead hint for blocks which are about to be decoded */
+    void prefetch_blocks(const std::vector<uint64_t>& block_ids) const
     {
-        auto offset = m_blockmap.block_offset(block_id);
-        m_compressed_stream.seek(offset);
-        size_t out_size = block_size;
-        if (block_id == m_blockmap.num_blocks() - 1) {
-            auto left = text_size % block_size;
-            if (left != 0)
-                out_size = left;
+        page_advice::will_need(m_compressed_text, m_blockmap, block_ids);
+    }
+
+    /* hint that the encoded text is (no longer) read front to back */
+    void sequential_access(bool sequential) const
+    {
+        page_advice::sequential(m_compressed_text, sequential);
+    }
+
+    void enable_block_cache(size_t capacity_bytes, size_t num_shards = block_cache::default_shards)
+    {
+        m_block_cache.reset(new block_cache(capacity_bytes, num_shards));
+    }
+
+    block_cache_stats block_cache_statistics() const
+    {
+        if (m_block_cache)
+            return m_block_cache->stats();
+        return block_cache_stats();
+    }
+
+    inline uint64_t decode_block(context_type& ctx, uint64_t block_id, std::vector<uint8_t>& text) const
+    {
+        return decode_block(ctx, block_id, text.data(), text.size());
+    }
+
+    /* decodes the block into out, which holds out_size >= block_length(block_id) bytes */
+    inline uint64_t decode_block(context_type& ctx, uint64_t block_id, uint8_t* out, size_t out_size) const
+    {
+        if (m_block_cache) {
+            auto cached = m_block_cache->find(block_id);
+            if (cached != nullptr) {
+                std::copy(cached->begin(), cached->end(), out);
+                return cached->size();
+            }
+            auto decoded = decode_block_uncached(ctx, block_id, out);
+            m_block_cache->insert(block_id, out, decoded);
+            return decoded;
+        }
+        return decode_block_uncached(ctx, block_id, out);
+    }
+
+    /*
+        decodes the block into a caller buffer of out_size bytes without
+        allocating: the decode context is per-thread scratch reused across
+        calls. returns the number of bytes written.
+     */
+    uint64_t decode_block_into(uint64_t block_id, uint8_t* out, size_t out_size) const
+    {
+        if (block_id >= m_blockmap.num_blocks()) {
+            throw std::out_of_range("decode_block_into: block does not exist");
         }
-        coder.decode(m_compressed_stream, text.data(), out_size);
+        if (out_size < block_length(block_id)) {
+            throw std::invalid_argument("decode_block_into: output buffer smaller than block");
+        }
+        auto& ctx = scratch_contexts<context_type>::get(*this);
+        return decode_block(ctx, block_id, out, out_size);
+    }
+
+    /* decodes the given blocks in order and calls fn(j, text, size) for block_ids[j] */
+    template <class t_fn>
+    void decode_blocks(context_type& ctx, const std::vector<uint64_t>& block_ids, std::vector<uint8_t>& text, t_fn&& fn) const
+    {
+        for (size_t j = 0; j < block_ids.size(); j++) {
+            auto out_size = decode_block(ctx, block_ids[j], text);
+            fn(j, text.data(), out_size);
+        }
+    }
+
+    inline uint64_t decode_block_uncached(context_type& ctx, uint64_t block_id, std::vector<uint8_t>& text) const
+    {
+        return decode_block_uncached(ctx, block_id, text.data());
+    }
+
+    inline uint64_t decode_block_uncached(context_type& ctx, uint64_t block_id, uint8_t* out) const
+    {
+        auto offset = m_blockmap.block_offset(block_id);
+        ctx.stream.seek(offset);
+        size_t out_size = block_length(block_id);
+        ctx.coder.decode(ctx.stream, out, out_size);
         return out_size;
     }
 
+    std::vector<uint8_t>
+    block(context_type& ctx, const size_t block_id) const
+    {
+        std::vector<uint8_t> block_content(block_length(block_id));
+        decode_block(ctx, block_id, block_content.data(), block_content.size());
+        return block_content;
+    }
+
     std::vector<uint8_t>
     block(const size_t block_id) const
     {
-        std::vector<uint8_t> block_content(block_size);
-        auto out_size = decode_block(block_id, block_content, dummy);
-        if (out_size != block_size)
-            block_content.resize(out_size);
+        std::vector<uint8_t> block_content(block_length(block_id));
+        decode_block_into(block_id, block_content.data(), block_content.size());
         return block_content;
     }
+
+    void extract_batch(const std::vector<text_range>& ranges, const std::vector<uint8_t*>& out,
+        size_t num_threads = 1) const
+    {
+        ::extract_batch(*this, ranges, out, num_threads);
+    }
+
+    const docno_index& documents() const
+    {
+        return m_docno_index;
+    }
+
+    /* text of the document with the given id (line in the DOCORDER file). its blocks
+       are decoded on the calling thread unless num_threads asks for more */
+    std::vector<uint8_t> get_document(uint64_t doc_id, size_t num_threads = 1) const
+    {
+        return extract_document(*this, m_docno_index, doc_id, num_threads);
+    }
+
+    std::vector<uint8_t> get_document(const std::string& docno, size_t num_threads = 1) const
+    {
+        return extract_document(*this, m_docno_index, m_docno_index.doc_id(docno), num_threads);
+    }
 };
 
 template <class t_coder, uint32_t t_block_size>
@@ -153,6 +303,24 @@ public:
         return col.path + "/index/" + KEY_LZ + "-" + block_map_type::type() + "-" + base_type::type() + ".sdsl";
     }
 
+    static std::string manifest_type()
+    {
+        return "lz_store_static-" + base_type::type() + "-" + block_map_type::type();
+    }
+
+    static std::string manifest_file_name(collection& col)
+    {
+        return col.path + "/index/" + KEY_MANIFEST + "-" + manifest_type() + ".txt";
+    }
+
+    static void write_manifest(collection& col)
+    {
+        store_manifest manifest(col, manifest_type(), t_block_size, { KEY_LZ, KEY_BLOCKMAP, KEY_DOCNOINDEX });
+        auto manifest_file = manifest_file_name(col);
+        manifest.write(manifest_file);
+        col.file_map[KEY_MANIFEST] = manifest_file;
+    }
+
     static block_encodings encode_blocks(const uint8_t* data_ptr, size_t block_size, size_t blocks_to_encode, size_t id)
     {
         block_encodings be;
@@ -247,6 +415,12 @@ public:
         }
         col.file_map[KEY_BLOCKMAP] = blockmap_file;
 
+        // (5) docno index if the collection has a document order
+        docno_index::create(col, rebuild);
+
+        // (6) record the components so the store can be opened without the text
+        write_manifest(col);
+
         auto stop = hrclock::now();
         LOG(INFO) << "LZ construction complete. time = " << duration_cast<seconds>(stop - start).count() << " sec";
 
@@ -255,6 +429,17 @@ public:
 
     lz_store_static load(collection& col) const
     {
+        /* (1) a manifest lists all components and the text size */
+        auto manifest_file = manifest_file_name(col);
+        if (utils::file_exists(manifest_file)) {
+            LOG(INFO) << "Load store from manifest " << manifest_file;
+            auto manifest = store_manifest::read(manifest_file);
+            manifest.check(manifest_type(), t_block_size);
+            manifest.apply(col);
+            col.file_map[KEY_MANIFEST] = manifest_file;
+            return lz_store_static(col);
+        }
+
         /* (2) check factorized text */
         auto enc_file_name = encoding_file_name(col);
         if (!utils::file_exists(enc_file_name)) {
@@ -274,6 +459,12 @@ public:
             col.file_map[KEY_BLOCKMAP] = blockmap_file;
         }
 
+        /* (3) optional docno index */
+        auto docnoindex_file = docno_index::file_name(col);
+        if (utils::file_exists(docnoindex_file)) {
+            col.file_map[KEY_DOCNOINDEX] = docnoindex_file;
+        }
+
         /* load */
         return lz_store_static(col);
     }
@@ -0,0 +1,93 @@
+#pragma once
+
+#include <sched.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <cstdint>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+/*
+    the few NUMA primitives needed to replicate read-only structures
+    per node. they use the raw syscalls and sysfs so there is no
+    dependency on libnuma. on machines with a single node (or kernels
+    without NUMA support) everything degrades to node 0.
+ */
+namespace numa {
+
+const int mpol_bind = 2; // MPOL_BIND from linux/mempolicy.h
+const unsigned mpol_mf_move = 1 << 1; // MPOL_MF_MOVE
+
+inline std::string node_path(size_t node)
+{
+    return "/sys/devices/system/node/node" + std::to_string(node);
+}
+
+/* number of consecutive nodes node0..nodeN-1 in sysfs, at least 1 */
+inline size_t num_nodes()
+{
+    size_t n = 0;
+    while (std::ifstream(node_path(n) + "/cpulist"))
+        n++;
+    return n ? n : 1;
+}
+
+/* node of the cpu the calling thread runs on */
+inline size_t current_node()
+{
+#ifdef SYS_getcpu
+    unsigned cpu = 0, node = 0;
+    if (syscall(SYS_getcpu, &cpu, &node, nullptr) == 0)
+        return node;
+#endif
+    return 0;
+}
+
+/* cpus of a node, parsed from its sysfs cpulist ("0-3,8-11") */
+inline std::vector<int> node_cpus(size_t node)
+{
+    std::vector<int> cpus;
+    std::ifstream ifs(node_path(node) + "/cpulist");
+    std::string range;
+    while (std::getline(ifs, range, ',')) {
+        std::istringstream iss(range);
+        int beg = 0, end = 0;
+        char dash = 0;
+        if (!(iss >> beg))
+            continue;
+        end = (iss >> dash >> end) ? end : beg;
+        for (int c = beg; c <= end; c++)
+            cpus.push_back(c);
+    }
+    return cpus;
+}
+
+/* restricts the calling thread to the cpus of a node */
+inline bool run_on_node(size_t node)
+{
+    auto cpus = node_cpus(node);
+    if (cpus.empty())
+        return false;
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for (auto c : cpus)
+        CPU_SET(c, &set);
+    return sched_setaffinity(0, sizeof(set), &set) == 0;
+}
+
+/* places the (page aligned, not yet touched) pages of [ptr,ptr+len) on a node */
+inline bool bind(void* ptr, size_t len, size_t node)
+{
+#ifdef SYS_mbind
+    std::vector<unsigned long> mask(node / 64 + 1, 0);
+    mask[node / 64] |= 1UL << (node % 64);
+    unsigned long max_node = mask.size() * 64 + 1;
+    return syscall(SYS_mbind, ptr, len, mpol_bind, mask.data(), max_node, mpol_mf_move) == 0;
+#else
+    return false;
+#endif
+}
+}
@@ -0,0 +1,82 @@
+#pragma once
+
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+/*
+    access hints for the mapped encoded text of a store. on a cold page
+    cache every block of a random batch costs one synchronous major
+    fault. telling the kernel about all blocks of a batch up front
+    (MADV_WILLNEED) lets it read them concurrently. full scans switch
+    the mapping to MADV_SEQUENTIAL for aggressive read-ahead.
+
+    t_bv is the mapped bit stream (data() in 64-bit words, size() in
+    bits) and block offsets are bit offsets into it, as stored in the
+    block maps.
+ */
+namespace page_advice {
+
+inline uintptr_t page_size()
+{
+    static const uintptr_t ps = sysconf(_SC_PAGESIZE);
+    return ps;
+}
+
+/* byte range [first,second) of a block within the stream */
+template <class t_bv, class t_block_map>
+std::pair<uint64_t, uint64_t> block_bytes(const t_bv& stream, const t_block_map& bmap, uint64_t block_id)
+{
+    uint64_t beg = bmap.block_offset(block_id);
+    uint64_t end = (block_id + 1 < bmap.num_blocks()) ? bmap.block_offset(block_id + 1) : stream.size();
+    return std::make_pair(beg >> 3, (end + 7) >> 3);
+}
+
+/* advises [beg,end) bytes of the stream, widened to whole pages */
+template <class t_bv>
+void advise_bytes(const t_bv& stream, uint64_t beg, uint64_t end, int advice)
+{
+    const uintptr_t base = (uintptr_t)stream.data();
+    uintptr_t first = (base + beg) & ~(page_size() - 1);
+    uintptr_t last = base + end;
+    if (last > first)
+        madvise((void*)first, last - first, advice);
+}
+
+/*
+    issues MADV_WILLNEED for the blocks. ranges closer than gap bytes
+    are merged so a batch costs few system calls.
+ */
+template <class t_bv, class t_block_map>
+void will_need(const t_bv& stream, const t_block_map& bmap, std::vector<uint64_t> block_ids,
+    uint64_t gap = 64 * 1024)
+{
+    if (block_ids.empty() || stream.data() == nullptr)
+        return;
+    std::sort(block_ids.begin(), block_ids.end());
+    auto cur = block_bytes(stream, bmap, block_ids[0]);
+    for (size_t i = 1; i < block_ids.size(); i++) {
+        auto next = block_bytes(stream, bmap, block_ids[i]);
+        if (next.first <= cur.second + gap) {
+            cur.second = std::max(cur.second, next.second);
+            continue;
+        }
+        advise_bytes(stream, cur.first, cur.second, MADV_WILLNEED);
+        cur = next;
+    }
+    advise_bytes(stream, cur.first, cur.second, MADV_WILLNEED);
+}
+
+/* the whole stream is read front to back (or back to random access) */
+template <class t_bv>
+void sequential(const t_bv& stream, bool seq)
+{
+    if (stream.data() == nullptr)
+        return;
+    advise_bytes(stream, 0, (stream.size() + 7) >> 3, seq ? MADV_SEQUENTIAL : MADV_NORMAL);
+}
+}
@@ -0,0 +1,154 @@
+#pragma once
+
+#include <algorithm>
+#include <condition_variable>
+#include <exception>
+#include <future>
+#include <mutex>
+#include <vector>
+
+/*
+    decodes the blocks [first_block,last_block) of a store with several
+    workers and passes them to consume(block_id, data, size) strictly in
+    block order on the calling thread.
+
+    the encoded blocks are requested from the page cache (MADV_WILLNEED)
+    one window ahead of the workers, so reads from a cold cache overlap
+    with decoding.
+
+    workers claim the next block to decode and write it to a slot of a
+    bounded reorder buffer. a worker may run at most window blocks ahead
+    of the consumer, which bounds the memory used to window blocks no
+    matter how slow the consumer is.
+ */
+template <class t_idx, class t_consumer>
+void parallel_decode(const t_idx& idx, size_t num_threads, t_consumer&& consume,
+    size_t first_block, size_t last_block, size_t window = 0)
+{
+    const size_t block_size = t_idx::block_size;
+    if (first_block >= last_block)
+        return;
+    num_threads = std::max<size_t>(num_threads, 1);
+    if (window < num_threads)
+        window = 4 * num_threads;
+    // the blocks of the window starting at block_id
+    auto prefetch = [&](size_t block_id) {
+        std::vector<uint64_t> ids;
+        for (size_t b = block_id; b < std::min(block_id + window, last_block); b++)
+            ids.push_back(b);
+        idx.prefetch_blocks(ids);
+    };
+    prefetch(first_block);
+
+    if (num_threads <= 1) {
+        auto ctx = idx.create_context();
+        std::vector<uint8_t> block_content(block_size);
+        for (size_t block_id = first_block; block_id < last_block; block_id++) {
+            if ((block_id - first_block) % window == 0)
+                prefetch(block_id + window);
+            auto decoded_syms = idx.decode_block(ctx, block_id, block_content);
+            consume(block_id, block_content.data(), decoded_syms);
+        }
+        return;
+    }
+
+    struct slot {
+        size_t block_id;
+        bool ready = false;
+        size_t size = 0;
+        std::vector<uint8_t> content;
+    };
+    std::vector<slot> slots(window);
+    for (auto& s : slots)
+        s.content.resize(block_size);
+
+    std::mutex mutex;
+    std::condition_variable cv;
+    size_t next_block = first_block;
+    size_t consumed = first_block;
+    bool stop = false;
+    std::exception_ptr error;
+
+    auto worker = [&]() {
+        try {
+            auto ctx = idx.create_context();
+            while (true) {
+                size_t block_id;
+                {
+                    std::unique_lock<std::mutex> lock(mutex);
+                    cv.wait(lock, [&] { return stop || next_block == last_block || next_block < consumed + window; });
+                    if (stop || next_block == last_block)
+                        return;
+                    block_id = next_block++;
+                }
+                if ((block_id - first_block) % window == 0)
+                    prefetch(block_id + window);
+                auto& s = slots[block_id % window];
+                s.size = idx.decode_block(ctx, block_id, s.content);
+                {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    s.block_id = block_id;
+                    s.ready = true;
+                }
+                cv.notify_all();
+            }
+        }
+        catch (...) {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (!error)
+                error = std::current_exception();
+            stop = true;
+            cv.notify_all();
+        }
+    };
+
+    std::vector<std::future<void> > workers;
+    for (size_t i = 0; i < num_threads; i++) {
+        workers.push_back(std::async(std::launch::async, worker));
+    }
+    try {
+        for (size_t block_id = first_block; block_id < last_block; block_id++) {
+            auto& s = slots[block_id % window];
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                cv.wait(lock, [&] { return stop || (s.ready && s.block_id == block_id); });
+                if (stop)
+                    break;
+            }
+            consume(block_id, s.content.data(), s.size);
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                s.ready = false;
+                consumed++;
+            }
+            cv.notify_all();
+        }
+    }
+    catch (...) {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!error)
+            error = std::current_exception();
+        stop = true;
+        cv.notify_all();
+    }
+    for (auto& w : workers) {
+        w.get();
+    }
+    if (error)
+        std::rethrow_exception(error);
+}
+
+/* a full scan, so the mapping of the encoded text is switched to sequential read-ahead */
+template <class t_idx, class t_consumer>
+void parallel_decode(const t_idx& idx, size_t num_threads, t_consumer&& consume)
+{
+    idx.sequential_access(true);
+    try {
+        parallel_decode(idx, num_threads, consume, 0, idx.block_map.num_blocks());
+    }
+    catch (...) {
+        idx.sequential_access(false);
+        throw;
+    }
+    idx.sequential_access(false);
+}
@@ -0,0 +1,176 @@
+#pragma once
+
+#include "sdsl/int_vector.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <stdexcept>
+#include <vector>
+
+/*
+    static rANS (asymmetric numeral systems) in the byte-wise
+    renormalising form of Giesen's rans_byte. the frequencies of a table
+    are scaled to prob_scale and never change, so a table is trained
+    once and then used for any number of blocks without sending it.
+    states are kept in [lower_bound, 256*lower_bound), so a symbol
+    emits at most two bytes. several states can share one byte stream
+    (interleaving) as long as the decoder uses them in exactly the
+    reverse order of the encoder.
+ */
+namespace rans {
+
+const uint32_t scale_bits = 12;
+const uint32_t prob_scale = 1 << scale_bits;
+const uint32_t lower_bound = 1u << 23;
+
+/*
+    values as 128 symbols: 0-15 directly, larger ones as their exponent
+    and the two bits below the leading one. the remaining low bits are
+    sent raw.
+ */
+const uint32_t split_symbols = 128;
+
+inline uint32_t split(uint32_t v, uint32_t& raw_bits)
+{
+    if (v < 16) {
+        raw_bits = 0;
+        return v;
+    }
+    uint32_t e = 31 - __builtin_clz(v);
+    raw_bits = e - 2;
+    return 16 + ((e - 4) << 2) + ((v >> (e - 2)) & 3);
+}
+
+/* the value of a split symbol without its raw bits */
+inline uint32_t unsplit(uint32_t sym, uint32_t& raw_bits)
+{
+    if (sym < 16) {
+        raw_bits = 0;
+        return sym;
+    }
+    uint32_t e = ((sym - 16) >> 2) + 4;
+    raw_bits = e - 2;
+    return (1u << e) | ((sym & 3) << (e - 2));
+}
+
+/* the frequencies of an alphabet of at most 256 symbols and the tables to code with them */
+class table {
+public:
+    using size_type = uint64_t;
+
+private:
+    sdsl::int_vector<16> m_freq;
+    std::vector<uint16_t> m_start;
+    std::vector<uint32_t> m_slots; // symbol | freq << 8 | start << 20 for each of the prob_scale slots
+
+    void build_slots()
+    {
+        m_start.resize(m_freq.size());
+        m_slots.resize(prob_scale);
+        uint32_t start = 0;
+        for (size_t sym = 0; sym < m_freq.size(); sym++) {
+            uint32_t freq = m_freq[sym];
+            m_start[sym] = start;
+            for (uint32_t i = 0; i < freq; i++)
+                m_slots[start + i] = sym | (freq << 8) | (start << 20);
+            start += freq;
+        }
+        if (start != prob_scale) {
+            throw std::runtime_error("rans::table: frequencies do not sum to prob_scale");
+        }
+    }
+
+public:
+    /*
+        scales the counts to prob_scale. every symbol gets a frequency of
+        at least one, so symbols never seen in training can still be coded.
+     */
+    void build(const std::vector<uint64_t>& counts)
+    {
+        if (counts.size() < 2 || counts.size() > 256) {
+            throw std::invalid_argument("rans::table: alphabet must have 2 to 256 symbols");
+        }
+        uint64_t total = 0;
+        for (auto c : counts)
+            total += c;
+        const uint64_t spare = prob_scale - counts.size();
+        m_freq.resize(counts.size());
+        uint64_t sum = 0;
+        size_t most_frequent = 0;
+        for (size_t sym = 0; sym < counts.size(); sym++) {
+            m_freq[sym] = 1 + (total ? (counts[sym] * spare) / total : 0);
+            sum += m_freq[sym];
+            if (counts[sym] > counts[most_frequent])
+                most_frequent = sym;
+        }
+        // the rounding error goes to the most frequent symbol
+        m_freq[most_frequent] = m_freq[most_frequent] + (prob_scale - sum);
+        build_slots();
+    }
+
+    size_t size() const
+    {
+        return m_freq.size();
+    }
+
+    uint32_t freq(uint32_t sym) const
+    {
+        return m_freq[sym];
+    }
+
+    /* encodes sym into state x, writing bytes backwards from ptr */
+    inline void encode(uint32_t& x, uint8_t*& ptr, uint32_t sym) const
+    {
+        uint32_t freq = m_freq[sym];
+        uint32_t x_max = ((lower_bound >> scale_bits) << 8) * freq;
+        while (x >= x_max) {
+            *--ptr = (uint8_t)x;
+            x >>= 8;
+        }
+        x = ((x / freq) << scale_bits) + (x % freq) + m_start[sym];
+    }
+
+    /* decodes a symbol from state x, reading bytes forwards from ptr */
+    inline uint32_t decode(uint32_t& x, const uint8_t*& ptr) const
+    {
+        uint32_t slot = m_slots[x & (prob_scale - 1)];
+        x = ((slot >> 8) & 0xFFF) * (x >> scale_bits) + (x & (prob_scale - 1)) - (slot >> 20);
+        while (x < lower_bound)
+            x = (x << 8) | *ptr++;
+        return slot & 0xFF;
+    }
+
+    size_type serialize(std::ostream& out, sdsl::structure_tree_node* v = NULL, std::string name = "") const
+    {
+        using namespace sdsl;
+        structure_tree_node* child = structure_tree::add_child(v, name, sdsl::util::class_name(*this));
+        size_type written_bytes = m_freq.serialize(out, child, "freq");
+        sdsl::structure_tree::add_size(child, written_bytes);
+        return written_bytes;
+    }
+
+    void load(std::istream& in)
+    {
+        m_freq.load(in);
+        build_slots();
+    }
+};
+
+/* the first state of a decoder, as written by flush */
+inline uint32_t init(const uint8_t*& ptr)
+{
+    uint32_t x = ptr[0] | (ptr[1] << 8) | (ptr[2] << 16) | ((uint32_t)ptr[3] << 24);
+    ptr += 4;
+    return x;
+}
+
+/* writes the final state of an encoder backwards from ptr */
+inline void flush(uint32_t x, uint8_t*& ptr)
+{
+    ptr -= 4;
+    ptr[0] = (uint8_t)x;
+    ptr[1] = (uint8_t)(x >> 8);
+    ptr[2] = (uint8_t)(x >> 16);
+    ptr[3] = (uint8_t)(x >> 24);
+}
+}
@@ -4,7 +4,23 @@
 #include "collection.hpp"
 
 #include "iterators.hpp"
+#include "decode_context.hpp"
+#include "dict_view.hpp"
+#include "bit_view.hpp"
+#include "store_container.hpp"
+#include "store_manifest.hpp"
+#include "store_options.hpp"
+#include "huge_pages.hpp"
+#include "numa.hpp"
+#include "copy_policy.hpp"
+#include "block_cache.hpp"
+#include "block_file_reader.hpp"
+#include "batch_extract.hpp"
+#include "page_advice.hpp"
+#include "docno_index.hpp"
+#include "text_segments.hpp"
 #include "block_maps.hpp"
+#include "factor_skip_index.hpp"
 #include "factor_selector.hpp"
 #include "factorizor.hpp"
 #include "factor_coder.hpp"
@@ -13,6 +29,8 @@
 
 #include <sdsl/suffix_arrays.hpp>
 
+#include <thread>
+
 using namespace std::chrono;
 
 template <class t_dictionary_creation_strategy,
@@ -22,7 +40,8 @@ template <class t_dictionary_creation_strategy,
     bool t_search_local_block_context,
     class t_factor_selection_strategy,
     class t_factor_coder,
-    class t_block_map>
+    class t_block_map,
+    class t_copy_policy = copy_std>
 class rlz_store_static {
 public:
     using dictionary_creation_strategy = t_dictionary_creation_strategy;
@@ -33,22 +52,39 @@ public:
     using factorization_strategy = factorizor<t_factorization_block_size, t_search_local_block_context,
         dictionary_index, factor_selection_strategy, factor_coder_type>;
     using block_map_type = t_block_map;
+    using copy_policy = t_copy_policy;
     using size_type = uint64_t;
+    using context_type = decode_context<factor_coder_type, bit_view>;
 
 private:
-    sdsl::int_vector_mapper<1, std::ios_base::in> m_factored_text;
-    bit_istream<sdsl::int_vector_mapper<1, std::ios_base::in> > m_factor_stream;
-    sdsl::int_vector<8> m_dict;
+    std::unique_ptr<sdsl::int_vector_mapper<1, std::ios_base::in> > m_factor_map;
+    std::unique_ptr<store_container> m_container; // owns all components when opened from a container
+    std::unique_ptr<block_file_reader> m_reader; // reads the factor stream with pread instead of mapping it
+    size_t m_io_queue_depth = 0;
+    bit_view m_factored_text;
+    sdsl::int_vector<8> m_dict_buf; // owns the dictionary when loaded onto the heap
+    std::unique_ptr<sdsl::int_vector_mapper<8, std::ios_base::in> > m_dict_map; // or when mapped
+    huge_pages::buffer m_dict_huge; // or when copied to huge pages
+    dict_view m_dict;
+    std::vector<huge_pages::buffer> m_dict_replicas; // one copy per numa node
+    std::vector<dict_view> m_dict_views;
+    std::vector<block_map_type> m_blockmap_replicas;
     block_map_type m_blockmap;
+    docno_index m_docno_index;
+    factor_skip_index m_skip_index;
+    std::unique_ptr<block_cache> m_block_cache;
+    std::shared_ptr<const typename coder_model<factor_coder_type>::type> m_coder_model; // shared by all contexts
+    bool m_dict_locked = false;
+    bool m_blockmap_locked = false;
+    uint64_t m_store_id = next_store_id();
 
 public:
     enum { block_size = t_factorization_block_size };
     enum { search_local_block_context = t_search_local_block_context };
     uint64_t encoding_block_size = block_size;
     block_map_type& block_map = m_blockmap;
-    sdsl::int_vector<8>& dict = m_dict;
-    factor_coder_type m_factor_coder;
-    sdsl::int_vector_mapper<1, std::ios_base::in>& factor_text = m_factored_text;
+    const dict_view& dict = m_dict;
+    const bit_view& factor_text = m_factored_text;
     uint64_t text_size;
     std::string m_dict_hash;
     std::string m_dict_file;
@@ -63,35 +99,285 @@ public:
         return dictionary_creation_strategy::type() + "-" + std::to_string(dict_size_mb) + "_"
             + dictionary_pruning_strategy::type() + "_"
             + factor_selection_strategy::type() + "_"
-            + factor_coder_type::type();
+            + factor_coder_type::type() + "_"
+            + copy_policy::type();
+    }
+
+private:
+    /* applies the huge page and mlock options to the dictionary and block map */
+    void place_in_memory(const store_options& opts)
+    {
+        if (opts.huge_pages) {
+            LOG(INFO) << "\tMove dictionary to huge pages";
+            if (m_dict_huge.assign(m_dict.data(), m_dict.size(), opts.mlock)) {
+                m_dict = dict_view(m_dict_huge.data(), m_dict_huge.size());
+                m_dict_buf = sdsl::int_vector<8>();
+                m_dict_map.reset();
+                m_dict_locked = m_dict_huge.locked();
+            }
+        }
+        if (opts.mlock) {
+            if (m_dict_huge.empty())
+                m_dict_locked = huge_pages::lock(m_dict.data(), m_dict.size());
+            m_blockmap_locked = true;
+            m_blockmap.for_each_region([this](const void* ptr, size_t len) {
+                if (len)
+                    m_blockmap_locked = huge_pages::lock(ptr, len) && m_blockmap_locked;
+            });
+            if (!m_dict_locked || !m_blockmap_locked) {
+                LOG(INFO) << "\tCould not lock all pages (RLIMIT_MEMLOCK)";
+            }
+        }
+        if (opts.numa_replicas) {
+            replicate(opts);
+        }
+    }
+
+    /* copies the dictionary (and block map) to every numa node */
+    void replicate(const store_options& opts)
+    {
+        auto num_nodes = numa::num_nodes();
+        if (num_nodes < 2) {
+            LOG(INFO) << "\tSingle NUMA node. No replicas created";
+            return;
+        }
+        LOG(INFO) << "\tReplicate dictionary on " << num_nodes << " NUMA nodes";
+        m_dict_replicas.resize(num_nodes);
+        m_dict_locked = opts.mlock;
+        for (size_t node = 0; node < num_nodes; node++) {
+            if (!m_dict_replicas[node].assign(m_dict.data(), m_dict.size(), opts.mlock, opts.huge_pages, node)) {
+                throw std::runtime_error("Cannot allocate dictionary replica for NUMA node " + std::to_string(node));
+            }
+            m_dict_views.emplace_back(m_dict_replicas[node].data(), m_dict_replicas[node].size());
+            m_dict_locked = m_dict_locked && m_dict_replicas[node].locked();
+        }
+        // the replica of node 0 replaces the original copy
+        m_dict = m_dict_views[0];
+        m_dict_huge = huge_pages::buffer();
+        m_dict_buf = sdsl::int_vector<8>();
+        m_dict_map.reset();
+
+        if (opts.numa_replicate_blockmap) {
+            LOG(INFO) << "\tReplicate block map on " << num_nodes << " NUMA nodes";
+            std::ostringstream oss;
+            m_blockmap.serialize(oss);
+            auto serialized = oss.str();
+            for (size_t node = 0; node < num_nodes; node++) {
+                /* loaded by a thread on the node so the pages are first touched there */
+                auto replica = std::async(std::launch::async, [node, &serialized]() {
+                    numa::run_on_node(node);
+                    block_map_type bm;
+                    std::istringstream iss(serialized);
+                    bm.load(iss);
+                    return bm;
+                });
+                m_blockmap_replicas.push_back(replica.get());
+            }
+        }
+    }
+
+    inline const dict_view& local_dict(const context_type& ctx) const
+    {
+        return m_dict_views.empty() ? m_dict : m_dict_views[ctx.replica];
+    }
+
+    inline const block_map_type& local_blockmap(const context_type& ctx) const
+    {
+        return m_blockmap_replicas.empty() ? m_blockmap : m_blockmap_replicas[ctx.replica];
+    }
+
+public:
+    /* the layout of the encoding, independent of the dictionary used */
+    static std::string layout_type()
+    {
+        return "rlz_store_static-" + factorization_strategy::type() + "-" + block_map_type::type();
     }
 
     rlz_store_static() = delete;
-    rlz_store_static(rlz_store_static&&) = default;
-    rlz_store_static& operator=(rlz_store_static&&) = default;
-    rlz_store_static(collection& col)
-        : m_factored_text(col.file_map[KEY_FACTORIZED_TEXT])
-        , m_factor_stream(m_factored_text) // (1) mmap factored text
+
+    /*
+        the streams of decode contexts point into the store, so a moved
+        store takes a fresh id and the contexts threads cached for the
+        old one (see scratch_contexts) are never handed out for it. the
+        moved-from store gets a fresh id as well, so the old id is never
+        matched again. the public references keep referring to the
+        members of their own store.
+     */
+    rlz_store_static(rlz_store_static&& other)
+    {
+        *this = std::move(other);
+    }
+
+    rlz_store_static& operator=(rlz_store_static&& other)
+    {
+        if (this != &other) {
+            m_factor_map = std::move(other.m_factor_map);
+            m_container = std::move(other.m_container);
+            m_reader = std::move(other.m_reader);
+            m_io_queue_depth = other.m_io_queue_depth;
+            m_factored_text = other.m_factored_text;
+            m_dict_buf = std::move(other.m_dict_buf);
+            m_dict_map = std::move(other.m_dict_map);
+            m_dict_huge = std::move(other.m_dict_huge);
+            m_dict = other.m_dict;
+            m_dict_replicas = std::move(other.m_dict_replicas);
+            m_dict_views = std::move(other.m_dict_views);
+            m_blockmap_replicas = std::move(other.m_blockmap_replicas);
+            m_blockmap = std::move(other.m_blockmap);
+            m_docno_index = std::move(other.m_docno_index);
+            m_skip_index = std::move(other.m_skip_index);
+            m_block_cache = std::move(other.m_block_cache);
+            m_coder_model = std::move(other.m_coder_model);
+            m_dict_locked = other.m_dict_locked;
+            m_blockmap_locked = other.m_blockmap_locked;
+            encoding_block_size = other.encoding_block_size;
+            text_size = other.text_size;
+            m_dict_hash = std::move(other.m_dict_hash);
+            m_dict_file = std::move(other.m_dict_file);
+            m_factor_file = std::move(other.m_factor_file);
+            m_store_id = next_store_id();
+            other.m_store_id = next_store_id();
+        }
+        return *this;
+    }
+
+    rlz_store_static(collection& col, const store_options& opts = store_options())
     {
         LOG(INFO) << "Loading RLZ store into memory";
+        // (1) mmap factored text or read it on demand
+        if (opts.pread_factors) {
+            LOG(INFO) << "\tRead factored text with pread" << (opts.direct_io ? " (O_DIRECT)" : "");
+            m_reader.reset(block_file_reader::open_sdsl(col.file_map[KEY_FACTORIZED_TEXT],
+                opts.factor_cache_bytes, opts.direct_io));
+            m_io_queue_depth = opts.io_queue_depth;
+            m_factored_text = bit_view(nullptr, m_reader->size());
+        }
+        else {
+            m_factor_map.reset(new sdsl::int_vector_mapper<1, std::ios_base::in>(col.file_map[KEY_FACTORIZED_TEXT]));
+            m_factored_text = bit_view(m_factor_map->data(), m_factor_map->size());
+        }
         m_factor_file = col.file_map[KEY_FACTORIZED_TEXT];
         // (2) load the block map
         LOG(INFO) << "\tLoad block map";
         sdsl::load_from_file(m_blockmap, col.file_map[KEY_BLOCKMAP]);
+        if (col.file_map.count(KEY_SKIPINDEX)) {
+            LOG(INFO) << "\tLoad factor skip index";
+            sdsl::load_from_file(m_skip_index, col.file_map[KEY_SKIPINDEX]);
+        }
+        if (col.file_map.count(KEY_DOCNOINDEX)) {
+            LOG(INFO) << "\tLoad docno index";
+            sdsl::load_from_file(m_docno_index, col.file_map[KEY_DOCNOINDEX]);
+        }
 
         // (3) load dictionary from disk
         LOG(INFO) << "\tLoad dictionary";
         m_dict_hash = col.param_map[PARAM_DICT_HASH];
         m_dict_file = col.file_map[KEY_DICT];
-        sdsl::load_from_file(m_dict, col.file_map[KEY_DICT]);
-        {
-            LOG(INFO) << "\tDetermine text size";
-            const sdsl::int_vector_mapper<8, std::ios_base::in> text(col.file_map[KEY_TEXT]);
-            text_size = text.size();
+        if (opts.mmap_dict) {
+            m_dict_map.reset(new sdsl::int_vector_mapper<8, std::ios_base::in>(col.file_map[KEY_DICT]));
+            m_dict = dict_view((const uint8_t*)m_dict_map->data(), m_dict_map->size());
+        }
+        else {
+            sdsl::load_from_file(m_dict_buf, col.file_map[KEY_DICT]);
+            m_dict = dict_view((const uint8_t*)m_dict_buf.data(), m_dict_buf.size());
         }
+        text_size = col.text_size();
+        if (coder_model<factor_coder_type>::required) {
+            LOG(INFO) << "\tLoad factor coder model";
+            if (col.file_map.count(KEY_FCODER) == 0) {
+                throw std::runtime_error("LOAD FAILED: Cannot find factor coder model.");
+            }
+            m_coder_model = coder_model<factor_coder_type>::load(col.file_map[KEY_FCODER]);
+        }
+        place_in_memory(opts);
         LOG(INFO) << "RLZ store ready";
     }
 
+    /* opens a store written by export_container() with a single mapping */
+    explicit rlz_store_static(const std::string& container_file, const store_options& opts = store_options())
+        : m_container(new store_container(container_file))
+    {
+        LOG(INFO) << "Loading RLZ store from container " << container_file;
+        auto manifest = store_manifest::parse(std::string((const char*)m_container->get("manifest").data,
+            m_container->get("manifest").size));
+        manifest.check(layout_type(), block_size);
+        text_size = std::stoull(manifest.get(PARAM_TEXT_SIZE));
+        m_dict_hash = manifest.get(PARAM_DICT_HASH);
+        m_dict_file = m_factor_file = container_file;
+
+        const auto& factors = m_container->get("factors");
+        m_factored_text = bit_view((const uint64_t*)factors.data, std::stoull(manifest.get("factor_bits")));
+        if (factors.size * 8 < m_factored_text.size()) {
+            throw std::runtime_error("LOAD FAILED: Truncated factor stream in " + container_file);
+        }
+        if (opts.pread_factors) {
+            m_reader.reset(new block_file_reader(container_file, m_container->file_offset(factors),
+                m_factored_text.size(), opts.factor_cache_bytes, opts.direct_io));
+            m_io_queue_depth = opts.io_queue_depth;
+            m_factored_text = bit_view(nullptr, m_reader->size());
+        }
+        const auto& dict_section = m_container->get("dict");
+        m_dict = dict_view(dict_section.data, dict_section.size);
+        m_container->load(m_blockmap, "blockmap");
+        if (m_container->has("skipindex")) {
+            m_container->load(m_skip_index, "skipindex");
+        }
+        if (m_container->has("docnoindex")) {
+            m_container->load(m_docno_index, "docnoindex");
+        }
+        if (coder_model<factor_coder_type>::required) {
+            std::shared_ptr<typename coder_model<factor_coder_type>::type> model(
+                new typename coder_model<factor_coder_type>::type());
+            m_container->load(*model, "fcoder");
+            m_coder_model = model;
+        }
+        place_in_memory(opts);
+        LOG(INFO) << "RLZ store ready";
+    }
+
+    /* packs the dictionary, factor stream and indexes into one file */
+    void export_container(const std::string& container_file) const
+    {
+        store_manifest manifest;
+        manifest.set("format", store_manifest::format_version());
+        manifest.set("store_type", layout_type());
+        manifest.set("block_size", std::to_string(block_size));
+        manifest.set("factor_bits", std::to_string(m_factored_text.size()));
+        manifest.set(PARAM_TEXT_SIZE, std::to_string(text_size));
+        manifest.set(PARAM_DICT_HASH, m_dict_hash);
+        auto manifest_str = manifest.str();
+
+        std::ostringstream blockmap_ss, skipindex_ss, docnoindex_ss, fcoder_ss;
+        m_blockmap.serialize(blockmap_ss);
+        m_skip_index.serialize(skipindex_ss);
+        m_docno_index.serialize(docnoindex_ss);
+        if (m_coder_model)
+            m_coder_model->serialize(fcoder_ss);
+        auto blockmap_str = blockmap_ss.str();
+        auto skipindex_str = skipindex_ss.str();
+        auto docnoindex_str = docnoindex_ss.str();
+        auto fcoder_str = fcoder_ss.str();
+
+        std::vector<store_container::section> sections;
+        sections.push_back({ "manifest", (const uint8_t*)manifest_str.data(), manifest_str.size() });
+        sections.push_back({ "dict", m_dict.data(), m_dict.size() });
+        auto factor_words = m_reader ? m_reader->read_words(0, m_factored_text.size()) : nullptr;
+        auto factor_data = m_reader ? factor_words->data() : (const uint8_t*)m_factored_text.data();
+        sections.push_back({ "factors", factor_data, ((m_factored_text.size() + 63) / 64) * 8 });
+        sections.push_back({ "blockmap", (const uint8_t*)blockmap_str.data(), blockmap_str.size() });
+        if (has_skip_index()) {
+            sections.push_back({ "skipindex", (const uint8_t*)skipindex_str.data(), skipindex_str.size() });
+        }
+        if (!m_docno_index.empty()) {
+            sections.push_back({ "docnoindex", (const uint8_t*)docnoindex_str.data(), docnoindex_str.size() });
+        }
+        if (m_coder_model) {
+            sections.push_back({ "fcoder", (const uint8_t*)fcoder_str.data(), fcoder_str.size() });
+        }
+        LOG(INFO) << "Write store container " << container_file;
+        store_container::write(container_file, sections);
+    }
+
     auto factors_begin() const -> factor_iterator<decltype(*this)>
     {
         return factor_iterator<decltype(*this)>(*this, 0, 0);
@@ -122,31 +408,250 @@ public:
         return m_dict.size() + (m_factored_text.size() >> 3) + m_blockmap.size_in_bytes();
     }
 
-    inline coder_size_info decode_factors(size_t offset,
-        block_factor_data& bfd,
-        size_t num_factors) const
+    /* identifies the instance for per-thread scratch, see scratch_contexts */
+    uint64_t store_id() const
     {
-        m_factor_stream.seek(offset);
-        return m_factor_coder.decode_block(m_factor_stream, bfd, num_factors);
+        return m_store_id;
     }
 
-    inline uint64_t decode_block(uint64_t block_id, std::vector<uint8_t>& text, block_factor_data& bfd) const
+    /* number of text bytes in the block */
+    uint64_t block_length(uint64_t block_id) const
     {
-        auto block_start = m_blockmap.block_offset(block_id);
-        auto num_factors = m_blockmap.block_factors(block_id);
-        decode_factors(block_start, bfd, num_factors);
+        return std::min<uint64_t>(block_size, text_size - block_id * block_size);
+    }
+
+    /* the context uses the replicas of the numa node of the calling thread */
+    context_type create_context() const
+    {
+        context_type ctx(m_factored_text, block_size);
+        coder_model<factor_coder_type>::use(ctx.coder, m_coder_model);
+        if (!m_dict_views.empty())
+            ctx.replica = numa::current_node() % m_dict_views.size();
+        return ctx;
+    }
+
+    /* the pread backend's request for the encoded bits of a block */
+    inline block_file_reader::block_request fetch_request(const block_map_type& bmap, uint64_t block_id) const
+    {
+        auto end = (block_id + 1 < bmap.num_blocks()) ? bmap.block_offset(block_id + 1) : m_factored_text.size();
+        return { block_id, bmap.block_offset(block_id), end };
+    }
+
+    inline void set_fetched(context_type& ctx, uint64_t block_id, const block_file_reader::value_type& words) const
+    {
+        ctx.fetched_block = words;
+        ctx.fetched_id = block_id;
+        ctx.fetched = bit_view((const uint64_t*)words->data(), words->size() * 8);
+    }
+
+    /* positions the stream of the context at the start of the block */
+    inline void seek_block(context_type& ctx, uint64_t block_id) const
+    {
+        const auto& bmap = local_blockmap(ctx);
+        auto offset = bmap.block_offset(block_id);
+        if (!m_reader) {
+            ctx.stream.seek(offset);
+            return;
+        }
+        if (ctx.fetched_block == nullptr || ctx.fetched_id != block_id) {
+            auto req = fetch_request(bmap, block_id);
+            set_fetched(ctx, block_id, m_reader->read(block_id, req.bit_beg, req.bit_end));
+        }
+        ctx.stream.reset(ctx.fetched, offset & 63);
+    }
+
+    inline coder_size_info decode_factors(context_type& ctx, size_t offset, size_t num_factors) const
+    {
+        if (m_reader) {
+            /* the block starting at offset */
+            const auto& bmap = local_blockmap(ctx);
+            size_t lb = 0, rb = bmap.num_blocks();
+            while (lb + 1 < rb) {
+                size_t mid = lb + (rb - lb) / 2;
+                if (bmap.block_offset(mid) <= offset)
+                    lb = mid;
+                else
+                    rb = mid;
+            }
+            seek_block(ctx, lb);
+        }
+        else {
+            ctx.stream.seek(offset);
+        }
+        return ctx.coder.decode_block(ctx.stream, ctx.bfd, num_factors);
+    }
+
+    inline coder_size_info decode_block_factors(context_type& ctx, uint64_t block_id) const
+    {
+        seek_block(ctx, block_id);
+        return ctx.coder.decode_block(ctx.stream, ctx.bfd, local_blockmap(ctx).block_factors(block_id));
+    }
+
+    /* statistics of the pread backend's cache of encoded blocks */
+    block_cache_stats factor_io_statistics() const
+    {
+        if (m_reader)
+            return m_reader->cache_statistics();
+        return block_cache_stats();
+    }
+
+    /* reports whether the huge page and mlock options took effect */
+    memory_placement placement() const
+    {
+        memory_placement p;
+        p.dict_bytes = m_dict.size();
+        p.dict_huge_page_bytes = huge_pages::backed_bytes(m_dict.data(), m_dict.size());
+        p.dict_locked = m_dict_locked;
+        m_blockmap.for_each_region([&p](const void* ptr, size_t len) {
+            p.blockmap_bytes += len;
+            p.blockmap_huge_page_bytes += huge_pages::backed_bytes(ptr, len);
+        });
+        p.blockmap_locked = m_blockmap_locked;
+        p.numa_replicas = m_dict_views.size();
+        return p;
+    }
+
+    /* read-ahead hint for blocks which are about to be decoded */
+    void prefetch_blocks(const std::vector<uint64_t>& block_ids) const
+    {
+        page_advice::will_need(m_factored_text, m_blockmap, block_ids);
+    }
+
+    /* hint that the encoded text is (no longer) read front to back */
+    void sequential_access(bool sequential) const
+    {
+        page_advice::sequential(m_factored_text, sequential);
+    }
+
+    void enable_block_cache(size_t capacity_bytes, size_t num_shards = block_cache::default_shards)
+    {
+        m_block_cache.reset(new block_cache(capacity_bytes, num_shards));
+    }
+
+    block_cache_stats block_cache_statistics() const
+    {
+        if (m_block_cache)
+            return m_block_cache->stats();
+        return block_cache_stats();
+    }
+
+    inline uint64_t decode_block(context_type& ctx, uint64_t block_id, std::vector<uint8_t>& text) const
+    {
+        return decode_block(ctx, block_id, text.data(), text.size());
+    }
+
+    /* decodes the block into out, which holds out_size >= block_length(block_id) bytes */
+    inline uint64_t decode_block(context_type& ctx, uint64_t block_id, uint8_t* out, size_t out_size) const
+    {
+        if (m_block_cache) {
+            auto cached = m_block_cache->find(block_id);
+            if (cached != nullptr) {
+                std::copy(cached->begin(), cached->end(), out);
+                return cached->size();
+            }
+            auto decoded_syms = decode_block_uncached(ctx, block_id, out, out + out_size);
+            m_block_cache->insert(block_id, out, decoded_syms);
+            return decoded_syms;
+        }
+        return decode_block_uncached(ctx, block_id, out, out + out_size);
+    }
+
+    /*
+        decodes the block into a caller buffer of out_size bytes without
+        allocating: the decode context is per-thread scratch reused across
+        calls. returns the number of bytes written.
+     */
+    uint64_t decode_block_into(uint64_t block_id, uint8_t* out, size_t out_size) const
+    {
+        if (block_id >= m_blockmap.num_blocks()) {
+            throw std::out_of_range("decode_block_into: block does not exist");
+        }
+        if (out_size < block_length(block_id)) {
+            throw std::invalid_argument("decode_block_into: output buffer smaller than block");
+        }
+        auto& ctx = scratch_contexts<context_type>::get(*this);
+        return decode_block(ctx, block_id, out, out_size);
+    }
+
+    /*
+        decodes the given blocks and calls fn(j, text, size) for block_ids[j].
+        with the pread backend all reads of the batch are issued at once and
+        each block is decoded as soon as its read completes, so the order of
+        the calls is not the order of block_ids.
+     */
+    template <class t_fn>
+    void decode_blocks(context_type& ctx, const std::vector<uint64_t>& block_ids, std::vector<uint8_t>& text, t_fn&& fn) const
+    {
+        if (!m_reader || block_ids.size() < 2) {
+            for (size_t j = 0; j < block_ids.size(); j++) {
+                auto decoded_syms = decode_block(ctx, block_ids[j], text);
+                fn(j, text.data(), decoded_syms);
+            }
+            return;
+        }
+        std::vector<block_file_reader::block_request> requests;
+        std::vector<size_t> request_block;
+        for (size_t j = 0; j < block_ids.size(); j++) {
+            if (m_block_cache) {
+                auto cached = m_block_cache->find(block_ids[j]);
+                if (cached != nullptr) {
+                    fn(j, cached->data(), cached->size());
+                    continue;
+                }
+            }
+            requests.push_back(fetch_request(local_blockmap(ctx), block_ids[j]));
+            request_block.push_back(j);
+        }
+        m_reader->read_blocks(requests, m_io_queue_depth, [&](size_t i, const block_file_reader::value_type& words) {
+            auto j = request_block[i];
+            set_fetched(ctx, block_ids[j], words);
+            auto decoded_syms = decode_block_uncached(ctx, block_ids[j], text);
+            if (m_block_cache)
+                m_block_cache->insert(block_ids[j], text.data(), decoded_syms);
+            fn(j, text.data(), decoded_syms);
+        });
+    }
+
+    inline uint64_t decode_block_uncached(context_type& ctx, uint64_t block_id, std::vector<uint8_t>& text) const
+    {
+        return decode_block_uncached(ctx, block_id, text.data(), text.data() + text.size());
+    }
+
+    inline uint64_t decode_block_uncached(context_type& ctx, uint64_t block_id, uint8_t* out, uint8_t* out_end) const
+    {
+        return decode_block_uncached(ctx, block_id, out, out_end,
+            std::integral_constant<bool, factor_coder_type::fused_decoding>());
+    }
+
+    /* the coder writes the text while decoding the factors */
+    inline uint64_t decode_block_uncached(context_type& ctx, uint64_t block_id, uint8_t* out, uint8_t* out_end, std::true_type) const
+    {
+        seek_block(ctx, block_id);
+        auto num_factors = local_blockmap(ctx).block_factors(block_id);
+        const uint8_t* dict = local_dict(ctx).data();
+        return ctx.coder.template decode_block_text<t_search_local_block_context, copy_policy>(ctx.stream, ctx.bfd,
+            num_factors, dict, local_dict(ctx).size(), block_size, out, out_end);
+    }
+
+    /* decode all factors of the block first, then copy */
+    inline uint64_t decode_block_uncached(context_type& ctx, uint64_t block_id, uint8_t* out, uint8_t* out_end, std::false_type) const
+    {
+        auto num_factors = local_blockmap(ctx).block_factors(block_id);
+        decode_block_factors(ctx, block_id);
 
-        auto out_itr = text.begin();
+        const auto& bfd = ctx.bfd;
+        const uint8_t* dict = local_dict(ctx).data();
+        const uint8_t* dict_end = dict + local_dict(ctx).size();
+        const uint8_t* literals_end = bfd.literals.data() + bfd.literals.size();
+        uint8_t* out_itr = out;
         size_t literals_used = 0;
         size_t offsets_used = 0;
         for (size_t i = 0; i < num_factors; i++) {
             const auto& factor_len = bfd.lengths[i];
-            if (factor_len <= m_factor_coder.literal_threshold) {
+            if (factor_len <= factor_coder_type::literal_threshold) {
                 /* copy literals */
-                for (size_t i = 0; i < factor_len; i++) {
-                    *out_itr = bfd.literals[literals_used + i];
-                    out_itr++;
-                }
+                out_itr = copy_policy::copy(bfd.literals.data() + literals_used, factor_len, out_itr,
+                    literals_end, out_end);
                 literals_used += factor_len;
             }
             else {
@@ -154,36 +659,227 @@ public:
                 const auto& factor_offset = bfd.offsets[offsets_used];
                 if (t_search_local_block_context) {
                     if (factor_offset < block_size) { // local factor instead of global factor
-                        auto beg = text.begin() + factor_offset;
-                        std::copy(beg, beg + factor_len, out_itr);
+                        auto beg = out + factor_offset;
+                        out_itr = std::copy(beg, beg + factor_len, out_itr);
                     }
                     else {
-                        auto begin = m_dict.begin() + factor_offset - block_size;
-                        std::copy(begin, begin + factor_len, out_itr);
+                        auto begin = dict + factor_offset - block_size;
+                        out_itr = copy_policy::copy(begin, factor_len, out_itr, dict_end, out_end);
                     }
                 }
                 else {
-                    auto begin = m_dict.begin() + factor_offset;
-                    std::copy(begin, begin + factor_len, out_itr);
+                    auto begin = dict + factor_offset;
+                    out_itr = copy_policy::copy(begin, factor_len, out_itr, dict_end, out_end);
                 }
-                out_itr += factor_len;
                 offsets_used++;
             }
         }
-        auto written_syms = std::distance(text.begin(), out_itr);
+        auto written_syms = std::distance(out, out_itr);
         return written_syms;
     }
 
+    bool has_skip_index() const
+    {
+        return !m_skip_index.empty();
+    }
+
+    /* writes the len symbols starting at block_pos within the block to out.
+       with a skip index only the factors overlapping the range are copied.
+       without one, or if factors may refer to the block itself, the whole
+       block is decoded */
+    uint64_t decode_range(context_type& ctx, uint64_t block_id, uint64_t block_pos, uint64_t len, uint8_t* out) const
+    {
+        if (t_search_local_block_context || m_skip_index.empty()) {
+            auto& text = ctx.text;
+            text.resize(block_size);
+            auto decoded_syms = decode_block(ctx, block_id, text);
+            if (block_pos >= decoded_syms)
+                return 0;
+            len = std::min(len, decoded_syms - block_pos);
+            std::copy(text.begin() + block_pos, text.begin() + block_pos + len, out);
+            return len;
+        }
+        if (m_block_cache) {
+            auto cached = m_block_cache->find(block_id);
+            if (cached != nullptr) {
+                if (block_pos >= cached->size())
+                    return 0;
+                len = std::min<uint64_t>(len, cached->size() - block_pos);
+                std::copy(cached->begin() + block_pos, cached->begin() + block_pos + len, out);
+                return len;
+            }
+        }
+
+        auto num_factors = local_blockmap(ctx).block_factors(block_id);
+        seek_block(ctx, block_id);
+        ctx.coder.decode_lengths(ctx.stream, ctx.bfd, num_factors);
+        auto& bfd = ctx.bfd;
+
+        /* find the factors overlapping the range starting from the checkpoint */
+        auto cp = m_skip_index.find(block_id, block_pos);
+        auto range_end = block_pos + len;
+        size_t first_factor = cp.factor;
+        uint64_t first_text_pos = cp.text_pos;
+        size_t literals_before = cp.literal_pos;
+        size_t offsets_before = cp.offset_pos;
+        while (first_factor < num_factors && first_text_pos + bfd.lengths[first_factor] <= block_pos) {
+            const auto& factor_len = bfd.lengths[first_factor];
+            if (factor_len <= factor_coder_type::literal_threshold)
+                literals_before += factor_len;
+            else
+                offsets_before++;
+            first_text_pos += factor_len;
+            first_factor++;
+        }
+        size_t last_factor = first_factor;
+        uint64_t last_text_pos = first_text_pos;
+        size_t literals_end = literals_before;
+        size_t offsets_end = offsets_before;
+        while (last_factor < num_factors && last_text_pos < range_end) {
+            const auto& factor_len = bfd.lengths[last_factor];
+            if (factor_len <= factor_coder_type::literal_threshold)
+                literals_end += factor_len;
+            else
+                offsets_end++;
+            last_text_pos += factor_len;
+            last_factor++;
+        }
+        ctx.coder.decode_range(ctx.stream, bfd, literals_before, literals_end, offsets_before, offsets_end);
+
+        /* copy the overlapping parts */
+        auto out_itr = out;
+        auto text_pos = first_text_pos;
+        size_t literals_used = literals_before;
+        size_t offsets_used = offsets_before;
+        for (size_t i = first_factor; i < last_factor; i++) {
+            const auto& factor_len = bfd.lengths[i];
+            auto skip = (text_pos < block_pos) ? block_pos - text_pos : 0;
+            auto copy_len = std::min<uint64_t>(factor_len - skip, range_end - text_pos - skip);
+            if (factor_len <= factor_coder_type::literal_threshold) {
+                auto begin = bfd.literals.begin() + literals_used + skip;
+                out_itr = std::copy(begin, begin + copy_len, out_itr);
+                literals_used += factor_len;
+            }
+            else {
+                auto begin = local_dict(ctx).data() + bfd.offsets[offsets_used] + skip;
+                out_itr = copy_policy::copy(begin, copy_len, out_itr,
+                    local_dict(ctx).data() + local_dict(ctx).size(), out + len);
+                offsets_used++;
+            }
+            text_pos += factor_len;
+        }
+        return std::distance(out, out_itr);
+    }
+
+    /* copies len symbols starting at text offset to out. returns the number of symbols copied */
+    uint64_t extract(context_type& ctx, uint64_t offset, uint64_t len, uint8_t* out) const
+    {
+        len = std::min(len, text_size - std::min(offset, text_size));
+        uint64_t written = 0;
+        while (written != len) {
+            auto block_id = (offset + written) / block_size;
+            auto block_pos = (offset + written) % block_size;
+            auto block_len = std::min<uint64_t>(len - written, block_size - block_pos);
+            written += decode_range(ctx, block_id, block_pos, block_len, out + written);
+        }
+        return written;
+    }
+
+    /* describes the len symbols starting at text offset as segments pointing
+       into the dictionary plus literal runs copied into segs, so the text can
+       be written with writev without reconstructing it. the segments stay
+       valid while the store and segs live. with local search factors refer
+       to the block itself, so the overlapping part of such blocks is decoded
+       into segs */
+    uint64_t extract_segments(context_type& ctx, uint64_t offset, uint64_t len, text_segments& segs) const
+    {
+        segs.clear();
+        len = std::min(len, text_size - std::min(offset, text_size));
+        const uint8_t* dict = local_dict(ctx).data();
+        auto range_end = offset + len;
+        auto block_id = offset / block_size;
+        while (block_id * block_size < range_end) {
+            uint64_t block_beg = block_id * block_size;
+            auto from = std::max(offset, block_beg) - block_beg;
+            auto to = std::min<uint64_t>(range_end - block_beg, block_size);
+            if (t_search_local_block_context) {
+                auto& text = ctx.text;
+                text.resize(block_size);
+                decode_block(ctx, block_id, text);
+                segs.add_owned(text.data() + from, to - from);
+            }
+            else {
+                auto num_factors = local_blockmap(ctx).block_factors(block_id);
+                decode_block_factors(ctx, block_id);
+                const auto& bfd = ctx.bfd;
+                uint64_t text_pos = 0;
+                size_t literals_used = 0;
+                size_t offsets_used = 0;
+                for (size_t i = 0; i < num_factors && text_pos < to; i++) {
+                    const auto& factor_len = bfd.lengths[i];
+                    bool is_literal = factor_len <= factor_coder_type::literal_threshold;
+                    if (text_pos + factor_len > from) {
+                        auto skip = (text_pos < from) ? from - text_pos : 0;
+                        auto seg_len = std::min<uint64_t>(factor_len, to - text_pos) - skip;
+                        if (is_literal)
+                            segs.add_owned(bfd.literals.data() + literals_used + skip, seg_len);
+                        else
+                            segs.add_external(dict + bfd.offsets[offsets_used] + skip, seg_len);
+                    }
+                    if (is_literal)
+                        literals_used += factor_len;
+                    else
+                        offsets_used++;
+                    text_pos += factor_len;
+                }
+            }
+            block_id++;
+        }
+        segs.finalize();
+        return segs.size();
+    }
+
+    std::vector<uint8_t>
+    block(context_type& ctx, const size_t block_id) const
+    {
+        std::vector<uint8_t> block_content(block_length(block_id));
+        auto decoded_syms = decode_block(ctx, block_id, block_content.data(), block_content.size());
+        block_content.resize(decoded_syms);
+        return block_content;
+    }
+
     std::vector<uint8_t>
     block(const size_t block_id) const
     {
-        block_factor_data bfd(block_size);
-        std::vector<uint8_t> block_content(block_size);
-        auto decoded_syms = decode_block(block_id, block_content, bfd);
+        std::vector<uint8_t> block_content(block_length(block_id));
+        auto decoded_syms = decode_block_into(block_id, block_content.data(), block_content.size());
         block_content.resize(decoded_syms);
         return block_content;
     }
 
+    void extract_batch(const std::vector<text_range>& ranges, const std::vector<uint8_t*>& out,
+        size_t num_threads = 1) const
+    {
+        ::extract_batch(*this, ranges, out, num_threads);
+    }
+
+    const docno_index& documents() const
+    {
+        return m_docno_index;
+    }
+
+    /* text of the document with the given id (line in the DOCORDER file). its blocks
+       are decoded on the calling thread unless num_threads asks for more */
+    std::vector<uint8_t> get_document(uint64_t doc_id, size_t num_threads = 1) const
+    {
+        return extract_document(*this, m_docno_index, doc_id, num_threads);
+    }
+
+    std::vector<uint8_t> get_document(const std::string& docno, size_t num_threads = 1) const
+    {
+        return extract_document(*this, m_docno_index, m_docno_index.doc_id(docno), num_threads);
+    }
+
     std::pair<coder_size_info, std::vector<factor_data> >
     block_factors(const size_t block_id) const
     {
@@ -4,6 +4,7 @@
 #include "collection.hpp"
 
 #include "rlz_store_static.hpp"
+#include "store_manifest.hpp"
 
 template <class t_dictionary_creation_strategy,
     class t_dictionary_pruning_strategy,
@@ -12,7 +13,8 @@ template <class t_dictionary_creation_strategy,
     bool t_search_local_block_context,
     class t_factor_selection_strategy,
     class t_factor_coder,
-    class t_block_map>
+    class t_block_map,
+    class t_copy_policy>
 class rlz_store_static<t_dictionary_creation_strategy,
     t_dictionary_pruning_strategy,
     t_dictionary_index,
@@ -20,7 +22,8 @@ class rlz_store_static<t_dictionary_creation_strategy,
     t_search_local_block_context,
     t_factor_selection_strategy,
     t_factor_coder,
-    t_block_map>::builder {
+    t_block_map,
+    t_copy_policy>::builder {
 public:
     using dictionary_creation_strategy = t_dictionary_creation_strategy;
     using dictionary_pruning_strategy = t_dictionary_pruning_strategy;
@@ -53,6 +56,49 @@ public:
         pruned_dict_size_bytes = ds;
         return *this;
     };
+    builder& set_skip_index(bool si)
+    {
+        skip_index = si;
+        return *this;
+    };
+    builder& set_mmap_dict(bool md)
+    {
+        options.mmap_dict = md;
+        return *this;
+    };
+    builder& set_huge_pages(bool hp)
+    {
+        options.huge_pages = hp;
+        return *this;
+    };
+    builder& set_mlock(bool ml)
+    {
+        options.mlock = ml;
+        return *this;
+    };
+    builder& set_pread_factors(bool pf, size_t cache_bytes = 256 * 1024 * 1024, bool direct_io = false)
+    {
+        options.pread_factors = pf;
+        options.factor_cache_bytes = cache_bytes;
+        options.direct_io = direct_io;
+        return *this;
+    };
+    builder& set_io_queue_depth(size_t depth)
+    {
+        options.io_queue_depth = depth;
+        return *this;
+    };
+    builder& set_numa_replicas(bool nr, bool replicate_blockmap = false)
+    {
+        options.numa_replicas = nr;
+        options.numa_replicate_blockmap = replicate_blockmap;
+        return *this;
+    };
+    builder& set_container(const std::string& file)
+    {
+        container_file = file;
+        return *this;
+    };
 
     static std::string blockmap_file_name(collection& col)
     {
@@ -61,6 +107,50 @@ public:
             + col.param_map[PARAM_DICT_HASH] + ".sdsl";
     }
 
+    static std::string skipindex_file_name(collection& col)
+    {
+        return col.path + "/index/" + KEY_SKIPINDEX + "-"
+            + factor_skip_index::type() + "-" + factorization_strategy::type() + "-"
+            + col.param_map[PARAM_DICT_HASH] + ".sdsl";
+    }
+
+    static std::string manifest_type()
+    {
+        return rlz_store_static::layout_type();
+    }
+
+    /* named by the builder parameters only, so it can be found without the dictionary hash */
+    std::string manifest_file_name(collection& col) const
+    {
+        return col.path + "/index/" + KEY_MANIFEST + "-"
+            + dictionary_creation_strategy::type() + "-" + std::to_string(dict_size_bytes / (1024 * 1024)) + "-"
+            + dictionary_pruning_strategy::type() + "-" + std::to_string(pruned_dict_size_bytes / (1024 * 1024)) + "-"
+            + manifest_type() + ".txt";
+    }
+
+    void write_manifest(collection& col) const
+    {
+        store_manifest manifest(col, manifest_type(), block_size,
+            { KEY_DICT, KEY_FACTORIZED_TEXT, KEY_BLOCKOFFSETS, KEY_BLOCKFACTORS, KEY_BLOCKMAP,
+                KEY_SKIPINDEX, KEY_DOCNOINDEX, KEY_FCODER });
+        auto manifest_file = manifest_file_name(col);
+        manifest.write(manifest_file);
+        col.file_map[KEY_MANIFEST] = manifest_file;
+    }
+
+    void create_skip_index(collection& col) const
+    {
+        auto skipindex_file = skipindex_file_name(col);
+        if (rebuild || !utils::file_exists(skipindex_file)) {
+            LOG(INFO) << "Create factor skip index";
+            col.file_map.erase(KEY_SKIPINDEX);
+            rlz_store_static store(col, options);
+            factor_skip_index tmp(store);
+            sdsl::store_to_file(tmp, skipindex_file);
+        }
+        col.file_map[KEY_SKIPINDEX] = skipindex_file;
+    }
+
     rlz_store_static build_or_load(collection& col) const
     {
         auto start = hrclock::now();
@@ -87,6 +177,8 @@ public:
             col.file_map[KEY_FACTORIZED_TEXT] = factor_file_name;
             col.file_map[KEY_BLOCKOFFSETS] = factorization_strategy::boffsets_file_name(col);
             col.file_map[KEY_BLOCKFACTORS] = factorization_strategy::bfactors_file_name(col);
+            if (coder_model<factor_encoder>::required)
+                col.file_map[KEY_FCODER] = factorization_strategy::factorcoder_file_name(col);
         }
 
         // (4) encode document start pos
@@ -98,14 +190,46 @@ public:
         }
         col.file_map[KEY_BLOCKMAP] = blockmap_file;
 
+        // (5) optional checkpoints for partial block decoding
+        col.file_map.erase(KEY_SKIPINDEX);
+        if (skip_index) {
+            create_skip_index(col);
+        }
+
+        // (6) docno index if the collection has a document order
+        docno_index::create(col, rebuild);
+
+        // (7) record the components so the store can be opened without the text
+        write_manifest(col);
+        rlz_store_static store(col, options);
+
+        // (8) pack the store into a single file for deployment if requested
+        if (!container_file.empty()) {
+            store.export_container(container_file);
+        }
+
         auto stop = hrclock::now();
         LOG(INFO) << "RLZ construction complete. time = " << duration_cast<seconds>(stop - start).count() << " sec";
 
-        return rlz_store_static(col);
+        return store;
     }
 
     rlz_store_static load(collection& col) const
     {
+        /* (0) a manifest lists all components and needs neither the text nor a dictionary hash */
+        auto manifest_file = manifest_file_name(col);
+        if (utils::file_exists(manifest_file)) {
+            LOG(INFO) << "Load store from manifest " << manifest_file;
+            auto manifest = store_manifest::read(manifest_file);
+            manifest.check(manifest_type(), block_size);
+            manifest.apply(col);
+            if (skip_index && col.file_map.count(KEY_SKIPINDEX) == 0) {
+                throw std::runtime_error("LOAD FAILED: Cannot find skip index.");
+            }
+            col.file_map[KEY_MANIFEST] = manifest_file;
+            return rlz_store_static(col, options);
+        }
+
         /* make sure components exists and register them */
 
         /* (1) check dict */
@@ -130,6 +254,15 @@ public:
             col.file_map[KEY_BLOCKFACTORS] = factorization_strategy::bfactors_file_name(col);
         }
 
+        /* (2) check factor coder model */
+        if (coder_model<factor_encoder>::required) {
+            auto fcoder_file = factorization_strategy::factorcoder_file_name(col);
+            if (!utils::file_exists(fcoder_file)) {
+                throw std::runtime_error("LOAD FAILED: Cannot find factor coder model.");
+            }
+            col.file_map[KEY_FCODER] = fcoder_file;
+        }
+
         /* (2) check blockmap */
         auto blockmap_file = blockmap_file_name(col);
         if (!utils::file_exists(blockmap_file)) {
@@ -139,8 +272,23 @@ public:
             col.file_map[KEY_BLOCKMAP] = blockmap_file;
         }
 
+        /* (3) optional skip index */
+        auto skipindex_file = skipindex_file_name(col);
+        if (skip_index && !utils::file_exists(skipindex_file)) {
+            throw std::runtime_error("LOAD FAILED: Cannot find skip index.");
+        }
+        if (utils::file_exists(skipindex_file)) {
+            col.file_map[KEY_SKIPINDEX] = skipindex_file;
+        }
+
+        /* (4) optional docno index */
+        auto docnoindex_file = docno_index::file_name(col);
+        if (utils::file_exists(docnoindex_file)) {
+            col.file_map[KEY_DOCNOINDEX] = docnoindex_file;
+        }
+
         /* load */
-        return rlz_store_static(col);
+        return rlz_store_static(col, options);
     }
 
     template <class t_idx>
@@ -175,54 +323,44 @@ public:
 
         /* (2) reencode the factors */
         LOG(INFO) << "Reencoding factors (" << t_factor_coder::type() << ")";
-        auto itr = old.factors_begin();
-        auto end = old.factors_end();
-        block_factor_data bfd(t_factorization_block_size);
+        block_factor_data bfd(t_factorization_block_size, factor_layout::of<t_factor_coder>());
         auto factor_file_name = factorization_strategy::factor_file_name(col);
         auto boffsets_file_name = factorization_strategy::boffsets_file_name(col);
         auto bfactors_file_name = factorization_strategy::bfactors_file_name(col);
+        auto fcoder_file_name = factorization_strategy::factorcoder_file_name(col);
         if (rebuild || !utils::file_exists(factor_file_name)) {
+            t_factor_coder coder;
+            if (coder_model<t_factor_coder>::required) {
+                /* all factors are at hand, so the model is trained on all of them */
+                LOG(INFO) << "\t"
+                          << "Train factor coder model";
+                typename coder_model<t_factor_coder>::type model;
+                for_each_factor_block(old, coder, bfd, [&](block_factor_data& b) { model.count(b); });
+                model.build();
+                sdsl::store_to_file(model, fcoder_file_name);
+                coder_model<t_factor_coder>::use(coder, coder_model<t_factor_coder>::load(fcoder_file_name));
+            }
             auto factor_buf = sdsl::write_out_buffer<1>::create(factor_file_name);
             auto block_offsets = sdsl::write_out_buffer<0>::create(boffsets_file_name);
             auto block_factors = sdsl::write_out_buffer<0>::create(bfactors_file_name);
             bit_ostream<sdsl::int_vector_mapper<1> > factor_stream(factor_buf);
-            size_t cur_block_offset = itr.block_id;
-            t_factor_coder coder;
             auto num_blocks = old.block_map.num_blocks();
-            auto num_blocks10p = (uint64_t)(num_blocks * 0.1);
-
-            size_t syms_encoded = 0;
-            while (itr != end) {
-                const auto& f = *itr;
-                if (itr.block_id != cur_block_offset) {
-                    block_offsets.push_back(factor_stream.tellp());
-                    block_factors.push_back(bfd.num_factors);
-                    coder.encode_block(factor_stream, bfd);
-                    cur_block_offset = itr.block_id;
-                    bfd.reset();
-                    syms_encoded = 0;
-                    if ((cur_block_offset + 1) % num_blocks10p == 0) {
-                        LOG(INFO) << "\t"
-                                  << "Encoded " << 100 * (cur_block_offset + 1) / num_blocks << "% ("
-                                  << (cur_block_offset + 1) << "/" << num_blocks << ")";
-                    }
-                }
-
-                if (f.is_literal) {
-                    bfd.add_factor(coder, f.literal_ptr, 0, f.len);
-                }
-                else {
-                    bfd.add_factor(coder, f.literal_ptr, f.offset, f.len);
-                }
-                syms_encoded += f.len;
-                ++itr;
-            }
-            if (bfd.num_factors != 0) {
+            auto num_blocks10p = std::max<uint64_t>(1, num_blocks * 0.1);
+            uint64_t blocks_encoded = 0;
+            for_each_factor_block(old, coder, bfd, [&](block_factor_data& b) {
                 block_offsets.push_back(factor_stream.tellp());
-                block_factors.push_back(bfd.num_factors);
-                coder.encode_block(factor_stream, bfd);
-            }
+                block_factors.push_back(b.num_factors);
+                coder.encode_block(factor_stream, b);
+                blocks_encoded++;
+                if (blocks_encoded % num_blocks10p == 0) {
+                    LOG(INFO) << "\t"
+                              << "Encoded " << 100 * blocks_encoded / num_blocks << "% ("
+                              << blocks_encoded << "/" << num_blocks << ")";
+                }
+            });
         }
+        if (coder_model<t_factor_coder>::required)
+            col.file_map[KEY_FCODER] = fcoder_file_name;
         col.file_map[KEY_FACTORIZED_TEXT] = factor_file_name;
         col.file_map[KEY_BLOCKOFFSETS] = boffsets_file_name;
         col.file_map[KEY_BLOCKFACTORS] = bfactors_file_name;
@@ -235,14 +373,45 @@ public:
             sdsl::store_to_file(tmp, blockmap_file);
         }
         col.file_map[KEY_BLOCKMAP] = blockmap_file;
+        col.file_map.erase(KEY_SKIPINDEX);
+        if (skip_index) {
+            create_skip_index(col);
+        }
+        docno_index::create(col, rebuild);
+        write_manifest(col);
         auto stop = hrclock::now();
         LOG(INFO) << "RLZ factor reencode complete. time = " << duration_cast<seconds>(stop - start).count() << " sec";
-        return rlz_store_static(col);
+        return rlz_store_static(col, options);
     }
 
 private:
+    /* calls fn(bfd) with the factors of each block of old */
+    template <class t_idx, class t_fn>
+    static void for_each_factor_block(const t_idx& old, const t_factor_coder& coder, block_factor_data& bfd, t_fn fn)
+    {
+        auto itr = old.factors_begin();
+        auto end = old.factors_end();
+        size_t cur_block_offset = itr.block_id;
+        bfd.reset();
+        while (itr != end) {
+            const auto& f = *itr;
+            if (itr.block_id != cur_block_offset) {
+                fn(bfd);
+                cur_block_offset = itr.block_id;
+                bfd.reset();
+            }
+            bfd.add_factor(coder, f.literal_ptr, f.is_literal ? 0 : f.offset, f.len);
+            ++itr;
+        }
+        if (bfd.num_factors != 0)
+            fn(bfd);
+    }
+
     bool rebuild = false;
     uint32_t num_threads = 1;
     uint64_t dict_size_bytes = 0;
     uint64_t pruned_dict_size_bytes = 0;
+    bool skip_index = false;
+    std::string container_file;
+    store_options options;
 };
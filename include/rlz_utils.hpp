@@ -1,9 +1,11 @@
 #pragma once
 
 #include <chrono>
+#include <stdexcept>
 
 #include "utils.hpp"
 #include "factor_storage.hpp"
+#include "parallel_decoder.hpp"
 
 using namespace std::chrono;
 
@@ -38,20 +40,30 @@ void benchmark_factor_decoding(const t_idx& idx)
 }
 
 template <class t_idx>
-void benchmark_text_decoding(const t_idx& idx)
+void benchmark_text_decoding(const t_idx& idx, size_t num_threads = 1)
 {
     LOG(INFO) << "Measure text decoding speed (" << idx.type() << ")";
     auto start = hrclock::now();
-    auto itr = idx.begin();
-    auto end = idx.end();
 
     size_t checksum = 0;
     size_t num_syms = 0;
-    auto n = idx.size();
-    for (size_t i = 0; i < n; i++) {
-        checksum += *itr;
-        num_syms++;
-        ++itr;
+    if (num_threads <= 1) {
+        auto itr = idx.begin();
+        for (auto span = itr.next_span(); span.size != 0; span = itr.next_span()) {
+            for (size_t i = 0; i < span.size; i++) {
+                checksum += span.data[i];
+            }
+            num_syms += span.size;
+        }
+    }
+    else {
+        LOG(INFO) << "decoding threads = " << num_threads;
+        parallel_decode(idx, num_threads, [&](size_t, const uint8_t* data, size_t size) {
+            for (size_t i = 0; i < size; i++) {
+                checksum += data[i];
+            }
+            num_syms += size;
+        });
     }
     auto stop = hrclock::now();
     if (checksum == 0) {
@@ -85,23 +97,50 @@ void print_compressed_size(collection& col, t_idx& idx)
 }
 
 template <class t_idx>
-bool verify_index(collection& col, t_idx& idx)
+bool verify_index(collection& col, t_idx& idx, size_t num_threads = 1)
 {
     LOG(INFO) << "Verify that factorization is correct.";
     sdsl::read_only_mapper<8> text(col.file_map[KEY_TEXT]);
     auto num_blocks = text.size() / t_idx::block_size;
+    auto left = text.size() % t_idx::block_size;
 
+    // stops the decoder at the first block whose content differs
+    struct block_mismatch : std::runtime_error {
+        block_mismatch(size_t i)
+            : std::runtime_error("block " + std::to_string(i) + " not equal")
+        {
+        }
+    };
     bool error = false;
-    for (size_t i = 0; i < num_blocks; i++) {
-        auto block_content = idx.block(i);
+    auto verify_block = [&](size_t i, const uint8_t* block_content, size_t block_content_size) {
         auto block_start = i * t_idx::block_size;
-        if (block_content.size() != t_idx::block_size) {
+        if (i == num_blocks) {
+            if (block_content_size != left) {
+                error = true;
+                LOG(ERROR) << "Error in  LAST block "
+                           << " block size = " << block_content_size
+                           << " left  = " << left;
+            }
+            auto eq = std::equal(block_content, block_content + block_content_size, text.begin() + block_start);
+            if (!eq) {
+                error = true;
+                LOG(ERROR) << "LAST BLOCK IS NOT EQUAL";
+                for (size_t j = 0; j < left; j++) {
+                    if (text[block_start + j] != block_content[j]) {
+                        LOG_N_TIMES(100, ERROR) << "Error at pos " << j << "(" << block_start + j << ") should be '"
+                                                << (int)text[block_start + j] << "' is '" << (int)block_content[j] << "'";
+                    }
+                }
+            }
+            return;
+        }
+        if (block_content_size != t_idx::block_size) {
             error = true;
             LOG_N_TIMES(100, ERROR) << "Error in block " << i
-                                    << " block size = " << block_content.size()
+                                    << " block size = " << block_content_size
                                     << " encoding block_size = " << t_idx::block_size;
         }
-        auto eq = std::equal(block_content.begin(), block_content.end(), text.begin() + block_start);
+        auto eq = std::equal(block_content, block_content + block_content_size, text.begin() + block_start);
         if (!eq) {
             error = true;
             LOG(ERROR) << "BLOCK " << i << " NOT EQUAL";
@@ -111,30 +150,14 @@ bool verify_index(collection& col, t_idx& idx)
                                             << (int)text[block_start + j] << "' is '" << (int)block_content[j] << "'";
                 }
             }
-            exit(EXIT_FAILURE);
+            throw block_mismatch(i);
         }
+    };
+    try {
+        parallel_decode(idx, num_threads, verify_block, 0, num_blocks + (left ? 1 : 0));
     }
-    auto left = text.size() % t_idx::block_size;
-    if (left) {
-        auto block_content = idx.block(num_blocks);
-        auto block_start = num_blocks * t_idx::block_size;
-        if (block_content.size() != left) {
-            error = true;
-            LOG(ERROR) << "Error in  LAST block "
-                       << " block size = " << block_content.size()
-                       << " left  = " << left;
-        }
-        auto eq = std::equal(block_content.begin(), block_content.end(), text.begin() + block_start);
-        if (!eq) {
-            error = true;
-            LOG(ERROR) << "LAST BLOCK IS NOT EQUAL";
-            for (size_t j = 0; j < left; j++) {
-                if (text[block_start + j] != block_content[j]) {
-                    LOG_N_TIMES(100, ERROR) << "Error at pos " << j << "(" << block_start + j << ") should be '"
-                                            << (int)text[block_start + j] << "' is '" << (int)block_content[j] << "'";
-                }
-            }
-        }
+    catch (const block_mismatch&) {
+        error = true;
     }
     if (!error) {
         LOG(INFO) << "SUCCESS! Text sucessfully recovered.";
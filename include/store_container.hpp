@@ -0,0 +1,209 @@
+#pragma once
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <istream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+/*
+    a store packed into one file. the file starts with a table of
+    contents (a header followed by one fixed size entry per section)
+    and every section starts on a page boundary, so after mapping the
+    file once the sections can be used in place: the dictionary and
+    the factor stream are never copied or parsed. small sdsl
+    structures (block map, indexes) are loaded from their section.
+
+        [header][toc entries] pad | section 0 | pad | section 1 | ...
+ */
+class store_container {
+public:
+    static const uint64_t magic = 0x544e4f435a4c52ULL; // "RLZCONT"
+    static const uint64_t version = 1;
+    static const uint64_t page_size = 4096;
+    static const size_t max_name_len = 47;
+
+    struct section {
+        std::string name;
+        const uint8_t* data;
+        uint64_t size;
+    };
+
+private:
+    struct toc_header {
+        uint64_t magic;
+        uint64_t version;
+        uint64_t num_sections;
+        uint64_t file_size;
+    };
+    struct toc_entry {
+        char name[max_name_len + 1];
+        uint64_t offset;
+        uint64_t size;
+    };
+
+    struct membuf : std::streambuf {
+        membuf(const uint8_t* data, size_t size)
+        {
+            auto p = (char*)data;
+            setg(p, p, p + size);
+        }
+    };
+
+    std::string m_file_name;
+    uint8_t* m_data = nullptr;
+    uint64_t m_size = 0;
+    std::vector<section> m_sections;
+
+    static uint64_t page_align(uint64_t x)
+    {
+        return (x + page_size - 1) & ~(page_size - 1);
+    }
+
+public:
+    /* packs the sections into file_name */
+    static void write(const std::string& file_name, const std::vector<section>& sections)
+    {
+        std::vector<toc_entry> toc(sections.size());
+        uint64_t offset = page_align(sizeof(toc_header) + toc.size() * sizeof(toc_entry));
+        for (size_t i = 0; i < sections.size(); i++) {
+            if (sections[i].name.size() > max_name_len) {
+                throw std::invalid_argument("store_container: section name too long");
+            }
+            memset(&toc[i], 0, sizeof(toc_entry));
+            memcpy(toc[i].name, sections[i].name.data(), sections[i].name.size());
+            toc[i].offset = offset;
+            toc[i].size = sections[i].size;
+            offset = page_align(offset + sections[i].size);
+        }
+        toc_header hdr{ magic, version, sections.size(), offset };
+
+        auto tmp_file = file_name + ".tmp";
+        {
+            std::ofstream ofs(tmp_file, std::ios::binary | std::ios::trunc);
+            if (!ofs) {
+                throw std::runtime_error("Cannot write store container " + file_name);
+            }
+            const std::vector<char> zeros(page_size, 0);
+            ofs.write((const char*)&hdr, sizeof(hdr));
+            ofs.write((const char*)toc.data(), toc.size() * sizeof(toc_entry));
+            uint64_t written = sizeof(hdr) + toc.size() * sizeof(toc_entry);
+            for (size_t i = 0; i < sections.size(); i++) {
+                ofs.write(zeros.data(), toc[i].offset - written);
+                ofs.write((const char*)sections[i].data, sections[i].size);
+                written = toc[i].offset + sections[i].size;
+            }
+            ofs.write(zeros.data(), hdr.file_size - written);
+            if (!ofs) {
+                throw std::runtime_error("Cannot write store container " + file_name);
+            }
+        }
+        if (std::rename(tmp_file.c_str(), file_name.c_str()) != 0) {
+            throw std::runtime_error("Cannot write store container " + file_name);
+        }
+    }
+
+    store_container(const store_container&) = delete;
+    store_container& operator=(const store_container&) = delete;
+
+    /* maps the whole container read-only and checks the table of contents */
+    explicit store_container(const std::string& file_name)
+        : m_file_name(file_name)
+    {
+        int fd = open(file_name.c_str(), O_RDONLY);
+        if (fd < 0) {
+            throw std::runtime_error("LOAD FAILED: Cannot open store container " + file_name);
+        }
+        struct stat st;
+        if (fstat(fd, &st) != 0 || (uint64_t)st.st_size < sizeof(toc_header)) {
+            close(fd);
+            throw std::runtime_error("LOAD FAILED: Invalid store container " + file_name);
+        }
+        m_size = st.st_size;
+        void* ptr = mmap(nullptr, m_size, PROT_READ, MAP_SHARED, fd, 0);
+        close(fd);
+        if (ptr == MAP_FAILED) {
+            throw std::runtime_error("LOAD FAILED: Cannot map store container " + file_name);
+        }
+        m_data = (uint8_t*)ptr;
+
+        toc_header hdr;
+        memcpy(&hdr, m_data, sizeof(hdr));
+        if (hdr.magic != magic || hdr.version != version || hdr.file_size != m_size
+            || sizeof(hdr) + hdr.num_sections * sizeof(toc_entry) > m_size) {
+            munmap(m_data, m_size);
+            throw std::runtime_error("LOAD FAILED: Invalid store container " + file_name);
+        }
+        const toc_entry* toc = (const toc_entry*)(m_data + sizeof(hdr));
+        for (size_t i = 0; i < hdr.num_sections; i++) {
+            if (toc[i].offset % page_size != 0 || toc[i].offset > m_size || toc[i].size > m_size - toc[i].offset) {
+                munmap(m_data, m_size);
+                throw std::runtime_error("LOAD FAILED: Invalid store container " + file_name);
+            }
+            std::string name(toc[i].name, strnlen(toc[i].name, max_name_len));
+            m_sections.push_back({ name, m_data + toc[i].offset, toc[i].size });
+        }
+    }
+
+    ~store_container()
+    {
+        if (m_data)
+            munmap(m_data, m_size);
+    }
+
+    const std::string& file_name() const
+    {
+        return m_file_name;
+    }
+
+    uint64_t size() const
+    {
+        return m_size;
+    }
+
+    const std::vector<section>& sections() const
+    {
+        return m_sections;
+    }
+
+    bool has(const std::string& name) const
+    {
+        for (const auto& s : m_sections) {
+            if (s.name == name)
+                return true;
+        }
+        return false;
+    }
+
+    const section& get(const std::string& name) const
+    {
+        for (const auto& s : m_sections) {
+            if (s.name == name)
+                return s;
+        }
+        throw std::runtime_error("LOAD FAILED: Store container has no section '" + name + "'.");
+    }
+
+    /* position of a section within the file */
+    uint64_t file_offset(const section& s) const
+    {
+        return s.data - m_data;
+    }
+
+    /* loads a serialized sdsl structure from its section */
+    template <class t_obj>
+    void load(t_obj& obj, const std::string& name) const
+    {
+        const auto& s = get(name);
+        membuf buf(s.data, s.size);
+        std::istream in(&buf);
+        obj.load(in);
+    }
+};
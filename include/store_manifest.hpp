@@ -0,0 +1,168 @@
+#pragma once
+
+#include "utils.hpp"
+#include "collection.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+/*
+    a small text file written next to a store once it is built. it
+    records everything needed to open the store again: the parameters
+    otherwise derived from the input text (text size, dictionary hash)
+    and the component files. a store opened through its manifest never
+    touches the original text. one "key=value" pair per line; component
+    files are stored as "file.<KEY>" relative to the collection path.
+ */
+class store_manifest {
+public:
+    static std::string format_version()
+    {
+        return "1";
+    }
+
+private:
+    std::map<std::string, std::string> m_entries;
+
+    static std::string file_key(const std::string& key)
+    {
+        return "file." + key;
+    }
+
+public:
+    store_manifest() = default;
+
+    /* records the given components registered in the collection */
+    store_manifest(collection& col, const std::string& store_type, uint64_t block_size,
+        const std::vector<std::string>& keys)
+    {
+        set("format", format_version());
+        set("store_type", store_type);
+        set("block_size", std::to_string(block_size));
+        set(PARAM_TEXT_SIZE, std::to_string(col.text_size()));
+        if (std::find(keys.begin(), keys.end(), KEY_DICT) != keys.end()) {
+            set(PARAM_DICT_HASH, col.param_map[PARAM_DICT_HASH]);
+        }
+        for (const auto& key : keys) {
+            if (col.file_map.count(key) == 0)
+                continue;
+            auto file = col.file_map[key];
+            if (file.compare(0, col.path.size(), col.path) == 0) {
+                auto rel = file.find_first_not_of('/', col.path.size());
+                file = (rel == std::string::npos) ? std::string() : file.substr(rel);
+            }
+            set(file_key(key), file);
+        }
+    }
+
+    void set(const std::string& key, const std::string& value)
+    {
+        m_entries[key] = value;
+    }
+
+    bool has(const std::string& key) const
+    {
+        return m_entries.count(key) != 0;
+    }
+
+    const std::string& get(const std::string& key) const
+    {
+        auto itr = m_entries.find(key);
+        if (itr == m_entries.end()) {
+            throw std::runtime_error("LOAD FAILED: Manifest has no entry '" + key + "'.");
+        }
+        return itr->second;
+    }
+
+    std::string str() const
+    {
+        std::string s;
+        for (const auto& e : m_entries) {
+            s += e.first + "=" + e.second + "\n";
+        }
+        return s;
+    }
+
+    static store_manifest parse(const std::string& s)
+    {
+        store_manifest m;
+        std::istringstream iss(s);
+        std::string line;
+        while (std::getline(iss, line)) {
+            auto sep = line.find('=');
+            if (line.empty() || sep == std::string::npos)
+                continue;
+            m.set(line.substr(0, sep), line.substr(sep + 1));
+        }
+        if (!m.has("format") || m.get("format") != format_version()) {
+            throw std::runtime_error("LOAD FAILED: Unknown manifest format.");
+        }
+        return m;
+    }
+
+    void write(const std::string& file_name) const
+    {
+        auto tmp_file = file_name + ".tmp";
+        {
+            std::ofstream ofs(tmp_file);
+            if (!ofs) {
+                throw std::runtime_error("Cannot write manifest " + file_name);
+            }
+            ofs << str();
+        }
+        // readers never see a partially written manifest
+        if (std::rename(tmp_file.c_str(), file_name.c_str()) != 0) {
+            throw std::runtime_error("Cannot write manifest " + file_name);
+        }
+    }
+
+    static store_manifest read(const std::string& file_name)
+    {
+        std::ifstream ifs(file_name);
+        if (!ifs) {
+            throw std::runtime_error("LOAD FAILED: Cannot open manifest " + file_name);
+        }
+        std::stringstream buf;
+        buf << ifs.rdbuf();
+        return parse(buf.str());
+    }
+
+    /* checks the manifest describes a store with the given layout */
+    void check(const std::string& store_type, uint64_t block_size) const
+    {
+        if (get("store_type") != store_type) {
+            throw std::runtime_error("LOAD FAILED: Manifest describes store '" + get("store_type")
+                + "' instead of '" + store_type + "'.");
+        }
+        if (std::stoull(get("block_size")) != block_size) {
+            throw std::runtime_error("LOAD FAILED: Manifest block size does not match store.");
+        }
+    }
+
+    /* registers the recorded components and parameters with the collection */
+    void apply(collection& col) const
+    {
+        const std::string prefix = file_key("");
+        for (const auto& e : m_entries) {
+            if (e.first.compare(0, prefix.size(), prefix) == 0) {
+                auto file = e.second;
+                if (file.empty() || file[0] != '/') {
+                    file = col.path + file;
+                }
+                if (!utils::file_exists(file)) {
+                    throw std::runtime_error("LOAD FAILED: Cannot find " + file);
+                }
+                col.file_map[e.first.substr(prefix.size())] = file;
+            }
+        }
+        col.param_map[PARAM_TEXT_SIZE] = get(PARAM_TEXT_SIZE);
+        if (has(PARAM_DICT_HASH)) {
+            col.param_map[PARAM_DICT_HASH] = get(PARAM_DICT_HASH);
+        }
+    }
+};
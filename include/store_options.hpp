@@ -0,0 +1,41 @@
+#pragma once
+
+#include <cstddef>
+
+/*
+    runtime options used when a store is opened. they do not change
+    the on-disk format, only how the components are brought into memory.
+ */
+struct store_options {
+    // map the dictionary read-only instead of copying it to the heap.
+    // processes opening the same store share one page cache copy.
+    bool mmap_dict = false;
+    // back the dictionary with 2 MiB pages to cut TLB misses of random
+    // factor copies. the block map stays on the heap. see huge_pages.hpp
+    bool huge_pages = false;
+    // pin the dictionary and the block map in memory
+    bool mlock = false;
+    // one copy of the dictionary per numa node. decode contexts use
+    // the copy local to the thread creating them
+    bool numa_replicas = false;
+    // with numa_replicas, also one copy of the block map per node
+    bool numa_replicate_blockmap = false;
+    // read the factored text with pread into a cache of factor_cache_bytes
+    // instead of mapping it. direct_io bypasses the kernel page cache.
+    bool pread_factors = false;
+    bool direct_io = false;
+    size_t factor_cache_bytes = 256 * 1024 * 1024;
+    // reads the pread backend keeps in flight for a batch (io_uring); 0 reads one block at a time
+    size_t io_queue_depth = 64;
+};
+
+/* where the store components ended up, see store_options */
+struct memory_placement {
+    size_t dict_bytes = 0;
+    size_t dict_huge_page_bytes = 0;
+    bool dict_locked = false;
+    size_t blockmap_bytes = 0;
+    size_t blockmap_huge_page_bytes = 0;
+    bool blockmap_locked = false;
+    size_t numa_replicas = 0;
+};
@@ -0,0 +1,117 @@
+#pragma once
+
+#include <sys/uio.h>
+
+#include <cstdint>
+#include <vector>
+
+/*
+    a piece of text described as a list of iovecs for writev. most
+    segments point straight into memory owned by somebody else (the
+    dictionary of a store) and stay valid as long as that memory does.
+    bytes which do not exist anywhere else, such as literal runs, are
+    copied into a small arena owned by the segment list. adjacent
+    segments are merged. note that writev accepts at most IOV_MAX
+    segments per call.
+ */
+class text_segments {
+private:
+    std::vector<struct iovec> m_iov;
+    std::vector<bool> m_owned; // segment lives in the arena; iov_base holds the arena offset until finalize()
+    std::vector<uint8_t> m_arena;
+    size_t m_size = 0;
+    bool m_final = false;
+
+private:
+    // the arena may move while segments are added, so go back to offsets
+    void reopen()
+    {
+        for (size_t i = 0; i < m_iov.size(); i++) {
+            if (m_owned[i]) {
+                m_iov[i].iov_base = (void*)((uint8_t*)m_iov[i].iov_base - m_arena.data());
+            }
+        }
+        m_final = false;
+    }
+
+public:
+    void clear()
+    {
+        m_iov.clear();
+        m_owned.clear();
+        m_arena.clear();
+        m_size = 0;
+        m_final = false;
+    }
+
+    /* reference len bytes at ptr without copying them */
+    void add_external(const uint8_t* ptr, size_t len)
+    {
+        if (len == 0)
+            return;
+        if (m_final)
+            reopen();
+        m_size += len;
+        if (!m_iov.empty() && !m_owned.back()) {
+            auto& last = m_iov.back();
+            if ((const uint8_t*)last.iov_base + last.iov_len == ptr) {
+                last.iov_len += len;
+                return;
+            }
+        }
+        m_iov.push_back({ (void*)ptr, len });
+        m_owned.push_back(false);
+    }
+
+    /* copy len bytes at ptr into the arena */
+    void add_owned(const uint8_t* ptr, size_t len)
+    {
+        if (len == 0)
+            return;
+        if (m_final)
+            reopen();
+        m_size += len;
+        auto arena_offset = m_arena.size();
+        m_arena.insert(m_arena.end(), ptr, ptr + len);
+        if (!m_iov.empty() && m_owned.back()) {
+            m_iov.back().iov_len += len;
+            return;
+        }
+        m_iov.push_back({ (void*)arena_offset, len });
+        m_owned.push_back(true);
+    }
+
+    /* resolve the arena offsets once no more segments are added */
+    void finalize()
+    {
+        if (m_final)
+            return;
+        for (size_t i = 0; i < m_iov.size(); i++) {
+            if (m_owned[i]) {
+                m_iov[i].iov_base = m_arena.data() + (size_t)m_iov[i].iov_base;
+            }
+        }
+        m_final = true;
+    }
+
+    const struct iovec* iov() const
+    {
+        return m_iov.data();
+    }
+
+    size_t num_segments() const
+    {
+        return m_iov.size();
+    }
+
+    /* total number of text bytes described */
+    size_t size() const
+    {
+        return m_size;
+    }
+
+    size_t owned_bytes() const
+    {
+        return m_arena.size();
+    }
+};
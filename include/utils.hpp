@@ -147,6 +147,7 @@ typedef struct cmdargs {
     bool rebuild;
     uint32_t threads;
     bool verify;
+    std::string container_file;
 } cmdargs_t;
 
 void print_usage(const char* program)
@@ -156,6 +157,7 @@ void print_usage(const char* program)
     fprintf(stdout, "  -c <collection directory>  : the directory the collection is stored.\n");
     fprintf(stdout, "  -s <dict size in MB>       : size of the initial dictionary in MB.\n");
     fprintf(stdout, "  -t <threads>               : number of threads to use during factorization.\n");
+    fprintf(stdout, "  -f <store container>       : also pack the store into this single file.\n");
 };
 
 cmdargs_t
@@ -168,7 +170,8 @@ parse_args(int argc, const char* argv[])
     args.threads = 1;
     args.dict_size_in_bytes = 0;
     args.pruned_dict_size_in_bytes = 0;
-    while ((op = getopt(argc, (char* const*)argv, "c:s:t:")) != -1) {
+    args.container_file = "";
+    while ((op = getopt(argc, (char* const*)argv, "c:s:t:f:")) != -1) {
         switch (op) {
         case 'c':
             args.collection_dir = optarg;
@@ -179,6 +182,9 @@ parse_args(int argc, const char* argv[])
         case 't':
             args.threads = std::stoul(optarg);
             break;
+        case 'f':
+            args.container_file = optarg;
+            break;
         }
     }
     if (args.collection_dir == "") {
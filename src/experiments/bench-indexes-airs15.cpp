@@ -109,7 +109,7 @@ void create_indexes(collection& col,utils::cmdargs_t& args)
     }
     {
         /* RLZ-U32V  */
-        auto rlz_store = typename rlz_type_u32v_greedy_sp<t_factorization_blocksize>::builder{}
+        auto rlz_store = typename rlz_type_u32v_ts_greedy_sp<t_factorization_blocksize>::builder{}
                              .set_rebuild(args.rebuild)
                              .set_threads(args.threads)
                              .set_dict_size(dict_size_in_bytes)
@@ -56,8 +56,7 @@ void bench_index_rand(collection& col,const t_idx& idx,size_t dict_size_in_bytes
 		byte_offsets[i] = dis(g);
 	}
 	
-	std::vector<uint8_t> block_content(idx.encoding_block_size);
-	block_factor_data bfd(idx.encoding_block_size);
+	std::vector<uint8_t> ret_buf(block_ret_size);
 
 	auto itr = idx.begin();
 	auto start = hrclock::now();
@@ -66,10 +65,9 @@ void bench_index_rand(collection& col,const t_idx& idx,size_t dict_size_in_bytes
 	for(const auto bo: byte_offsets) {
 		auto text_ret_offset = bo;
 		itr.seek(text_ret_offset);
-		num_syms += block_ret_size;
-		for (size_t i = 0; i < block_ret_size; i++) {
-			checksum += *itr;
-			++itr;
+		num_syms += itr.read(ret_buf.data(), block_ret_size);
+		for (const auto sym : ret_buf) {
+			checksum += sym;
 		}
 	}
     auto stop = hrclock::now();
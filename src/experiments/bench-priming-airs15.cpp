@@ -37,21 +37,6 @@ void create_indexes(collection& col,utils::cmdargs_t& args)
                              .set_threads(args.threads)
                              .build_or_load(col);
 	}
-	{
-		/* ZLIB' */
-		const uint32_t prime_size = 32768;
-		using lzcoder = coder::zlib<9>;
-		auto lz_store = typename lz_store_static<
-									lzcoder,
-									t_factorization_blocksize,
-									dict_uniform_sample_budget<airs_sample_block_size>,
-									prime_size
-								>::builder{}
-                             .set_rebuild(args.rebuild)
-                             .set_threads(args.threads)
-                             .set_dict_size(dict_size_in_bytes)
-                             .build_or_load(col);
-	}
     {
         /* RLZ-ZZ */
         auto rlz_store = typename rlz_type_zz_greedy_sp<t_factorization_blocksize>::builder{}
@@ -69,6 +54,7 @@ void create_indexes(collection& col,utils::cmdargs_t& args)
                                          dict_prune_none,
                                          dict_index_csa<airs_csa_type>,
                                          t_factorization_blocksize,
+                                         false,
                                          factor_select_first,
                                          fcoder_type,
                                          block_map_uncompressed>;
@@ -95,8 +81,7 @@ void bench_index_rand(collection& col,const t_idx& idx,size_t dict_size_in_bytes
 		byte_offsets[i] = dis(g);
 	}
 	
-	std::vector<uint8_t> block_content(idx.encoding_block_size);
-	block_factor_data bfd(idx.encoding_block_size);
+	std::vector<uint8_t> ret_buf(block_ret_size);
 
 	auto itr = idx.begin();
 	auto start = hrclock::now();
@@ -105,10 +90,9 @@ void bench_index_rand(collection& col,const t_idx& idx,size_t dict_size_in_bytes
 	for(const auto bo: byte_offsets) {
 		auto text_ret_offset = bo;
 		itr.seek(text_ret_offset);
-		num_syms += block_ret_size;
-		for (size_t i = 0; i < block_ret_size; i++) {
-			checksum += *itr;
-			++itr;
+		num_syms += itr.read(ret_buf.data(), block_ret_size);
+		for (const auto sym : ret_buf) {
+			checksum += sym;
 		}
 	}
     auto stop = hrclock::now();
@@ -148,23 +132,6 @@ void bench_indexes_rand(collection& col,utils::cmdargs_t& args)
             bench_index_rand(col,lz_store,dict_size_in_bytes);
         }
 	} else {
-		{
-			/* ZLIB' */
-			const uint32_t prime_size = 32768;
-			using lzcoder = coder::zlib<9>;
-			auto lz_store = typename lz_store_static<
-										lzcoder,
-										t_factorization_blocksize,
-										dict_uniform_sample_budget<airs_sample_block_size>,
-										prime_size
-									>::builder{}
-	                             .set_rebuild(args.rebuild)
-	                             .set_threads(args.threads)
-	                             .set_dict_size(dict_size_in_bytes)
-	                             .load(col);
-
-	        bench_index_rand(col,lz_store,dict_size_in_bytes);
-		}
 	    {
 	        /* RLZ-ZZ */
 	        auto rlz_store = typename rlz_type_zz_greedy_sp<t_factorization_blocksize>::builder{}
@@ -184,6 +151,7 @@ void bench_indexes_rand(collection& col,utils::cmdargs_t& args)
 	                                         dict_prune_none,
 	                                         dict_index_csa<airs_csa_type>,
 	                                         t_factorization_blocksize,
+	                                         false,
 	                                         factor_select_first,
 	                                         fcoder_type,
 	                                         block_map_uncompressed>;
@@ -41,7 +41,6 @@ void create_indexes(collection& col,utils::cmdargs_t& args)
             auto lz_store = typename lz_store_static<coder::zlib<9>,t_factorization_blocksize>::builder{}
                                  .set_rebuild(args.rebuild)
                                  .set_threads(args.threads)
-                                 .set_dict_size(dict_size_in_bytes)
                                  .build_or_load(col);
 
             if(args.verify) verify_index(col, lz_store);
@@ -60,42 +59,13 @@ void create_indexes(collection& col,utils::cmdargs_t& args)
     }
     /* rlz compression */
     {
-        {
-            const uint32_t zlib_prime_size = 32768;
-            auto lz_store = typename lz_store_static<coder::zlib<9>,
-                                    t_factorization_blocksize,
-                                    dict_uniform_sample_budget<airs_sample_block_size>,
-                                    zlib_prime_size
-                                    >::builder{}
-                                 .set_rebuild(args.rebuild)
-                                 .set_threads(args.threads)
-                                 .set_dict_size(dict_size_in_bytes)
-                                 .build_or_load(col);
-
-            if(args.verify) verify_index(col, lz_store);
-        }
-        {
-            const uint32_t lz4_prime_size = 2*32768;
-            auto lz_store = typename lz_store_static<coder::lz4hc<16>,
-                                    t_factorization_blocksize,
-                                    dict_uniform_sample_budget<airs_sample_block_size>,
-                                    lz4_prime_size
-                                    >::builder{}
-                                 .set_rebuild(args.rebuild)
-                                 .set_threads(args.threads)
-                                 .set_dict_size(dict_size_in_bytes)
-                                 .build_or_load(col);
-
-            if(args.verify) verify_index(col, lz_store);
-        }
-
-        
         const uint32_t dict_size_in_bytes_log2 = CLog2<dict_size_in_bytes>();
     	/* RLZ-UV LOG(D)bit offsets */
         using rlz_type_uv_greedy_sp = rlz_store_static<dict_uniform_sample_budget<airs_sample_block_size>,
                                      dict_prune_none,
                                      dict_index_csa<airs_csa_type>,
                                      t_factorization_blocksize,
+                                     false,
                                      factor_select_first,
                                      factor_coder_blocked_twostream<1,coder::fixed<dict_size_in_bytes_log2>,coder::vbyte>,
                                      block_map_uncompressed>;
@@ -109,7 +79,7 @@ void create_indexes(collection& col,utils::cmdargs_t& args)
     }
     {
     	/* RLZ-U32V  */
-        auto rlz_store = typename rlz_type_u32v_greedy_sp<t_factorization_blocksize>::builder{}
+        auto rlz_store = typename rlz_type_u32v_ts_greedy_sp<t_factorization_blocksize>::builder{}
                              .set_rebuild(args.rebuild)
                              .set_threads(args.threads)
                              .set_dict_size(dict_size_in_bytes)
@@ -136,6 +106,7 @@ void create_indexes(collection& col,utils::cmdargs_t& args)
                                          dict_prune_none,
                                          dict_index_csa<airs_csa_type>,
                                          t_factorization_blocksize,
+                                         false,
                                          factor_select_first,
                                          fcoder_type,
                                          block_map_uncompressed>;
@@ -35,6 +35,7 @@ int main(int argc, const char* argv[])
                              block_map_uncompressed>::builder{}
                              .set_threads(args.threads)
                              .set_dict_size(args.dict_size_in_bytes)
+                             .set_container(args.container_file)
                              .build_or_load(col);
 
         verify_index(col, rlz_store);
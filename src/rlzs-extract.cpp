@@ -0,0 +1,145 @@
+#define ELPP_THREAD_SAFE
+#define ELPP_STL_LOGGING
+
+#include "utils.hpp"
+#include "collection.hpp"
+#include "rlz_utils.hpp"
+#include "parallel_decoder.hpp"
+
+#include "indexes.hpp"
+
+#include "logging.hpp"
+INITIALIZE_EASYLOGGINGPP
+
+typedef struct cmdargs {
+    std::string collection_dir;
+    std::string output_file;
+    std::string container_file;
+    size_t dict_size_in_bytes;
+    uint32_t threads;
+} cmdargs_t;
+
+void print_usage(const char* program)
+{
+    fprintf(stderr, "%s -c <collection directory> -s <dict size in MB> \n", program);
+    fprintf(stderr, "%s -f <store container> \n", program);
+    fprintf(stderr, "where\n");
+    fprintf(stderr, "  -c <collection directory>  : the directory the collection is stored.\n");
+    fprintf(stderr, "  -s <dict size in MB>       : the dictionary size of the store.\n");
+    fprintf(stderr, "  -t <threads>               : number of decoding threads.\n");
+    fprintf(stderr, "  -o <output file>           : write the text to this file instead of stdout.\n");
+    fprintf(stderr, "  -f <store container>       : open the store from a container written by rlzs-create.x -f.\n");
+};
+
+cmdargs_t
+parse_args(int argc, const char* argv[])
+{
+    cmdargs_t args;
+    int op;
+    args.collection_dir = "";
+    args.output_file = "";
+    args.container_file = "";
+    args.dict_size_in_bytes = 0;
+    args.threads = 1;
+    while ((op = getopt(argc, (char* const*)argv, "c:s:t:o:f:")) != -1) {
+        switch (op) {
+        case 'c':
+            args.collection_dir = optarg;
+            break;
+        case 's':
+            args.dict_size_in_bytes = std::stoul(optarg) * (1024 * 1024);
+            break;
+        case 't':
+            args.threads = std::stoul(optarg);
+            break;
+        case 'o':
+            args.output_file = optarg;
+            break;
+        case 'f':
+            args.container_file = optarg;
+            break;
+        }
+    }
+    if (args.threads == 0) {
+        std::cerr << "The number of threads must be at least 1.\n";
+        print_usage(argv[0]);
+        exit(EXIT_FAILURE);
+    }
+    if (args.container_file == "" && (args.collection_dir == "" || args.dict_size_in_bytes == 0)) {
+        std::cerr << "Missing command line parameters.\n";
+        print_usage(argv[0]);
+        exit(EXIT_FAILURE);
+    }
+    return args;
+}
+
+template <class t_idx>
+int extract_text(const t_idx& rlz_store, const cmdargs_t& args, bool to_stdout)
+{
+    FILE* out = stdout;
+    if (!to_stdout) {
+        out = fopen(args.output_file.c_str(), "wb");
+        if (out == nullptr) {
+            LOG(FATAL) << "Cannot open output file " << args.output_file;
+            return EXIT_FAILURE;
+        }
+    }
+    std::vector<char> out_buf(16 * 1024 * 1024);
+    setvbuf(out, out_buf.data(), _IOFBF, out_buf.size());
+
+    /* stream the text in block order */
+    LOG(INFO) << "Extracting text with " << args.threads << " threads";
+    auto start = hrclock::now();
+    size_t written = 0;
+    parallel_decode(rlz_store, args.threads, [&](size_t, const uint8_t* data, size_t size) {
+        if (fwrite(data, 1, size, out) != size) {
+            throw std::runtime_error("Error writing extracted text.");
+        }
+        written += size;
+    });
+    fflush(out);
+    auto stop = hrclock::now();
+    if (!to_stdout)
+        fclose(out);
+
+    auto seconds = duration_cast<milliseconds>(stop - start).count() / 1000.0;
+    LOG(INFO) << "extracted bytes = " << written;
+    LOG(INFO) << "total time = " << seconds << " sec";
+    LOG(INFO) << "extraction speed = " << (written / (1024 * 1024)) / seconds << " MB/s";
+
+    return EXIT_SUCCESS;
+}
+
+int main(int argc, const char* argv[])
+{
+    /* parse command line */
+    auto args = parse_args(argc, argv);
+    bool to_stdout = args.output_file.empty() || args.output_file == "-";
+    setup_logger(argc, argv, !to_stdout);
+
+    /* the rlz store created by rlzs-create.x */
+    const uint32_t factorization_blocksize = 64 * 1024;
+    using store_type = rlz_store_static<dict_uniform_sample_budget<default_dict_sample_block_size>,
+        dict_prune_none,
+        dict_index_csa<>,
+        factorization_blocksize,
+        false,
+        factor_select_first,
+        factor_coder_blocked<3, coder::zlib<9>, coder::zlib<9>, coder::zlib<9> >,
+        block_map_uncompressed>;
+
+    if (args.container_file != "") {
+        const store_type rlz_store(args.container_file);
+        return extract_text(rlz_store, args, to_stdout);
+    }
+
+    /* parse the collection */
+    LOG(INFO) << "Parsing collection directory " << args.collection_dir;
+    collection col(args.collection_dir, false);
+
+    /* load the store (through its manifest if the text is gone) */
+    auto rlz_store = store_type::builder{}
+                         .set_dict_size(args.dict_size_in_bytes)
+                         .load(col);
+    return extract_text(rlz_store, args, to_stdout);
+}
@@ -2,10 +2,27 @@
 #include "sdsl/int_vector.hpp"
 #include "bit_streams.hpp"
 #include "bit_coders.hpp"
+#include "factor_coder.hpp"
+#include "block_cache.hpp"
+#include "text_segments.hpp"
+#include "store_container.hpp"
+#include "block_file_reader.hpp"
+#include "batch_extract.hpp"
 #include <functional>
 #include <random>
+#include <thread>
 
 #include "utils.hpp"
+#include "collection.hpp"
+#include "rlz_utils.hpp"
+#include "block_maps.hpp"
+#include "factor_selector.hpp"
+#include "dict_strategies.hpp"
+#include "dict_indexes.hpp"
+#include "rlz_store_static.hpp"
+#include "rlz_store_static_builder.hpp"
+#include "lz_store_static.hpp"
+#include "store_manifest.hpp"
 
 #include "logging.hpp"
 INITIALIZE_EASYLOGGINGPP
@@ -41,6 +58,109 @@ TEST(bit_stream, vbyte)
     }
 }
 
+TEST(bit_stream, align8)
+{
+    // byte aligned coders start at the next byte boundary and keep the bits before it
+    std::vector<uint32_t> A = { 1, 200, 70000, 3 };
+    for (size_t start = 0; start < 130; start++) {
+        sdsl::bit_vector bv;
+        {
+            bit_ostream<sdsl::bit_vector> os(bv);
+            for (size_t i = 0; i < start; i++)
+                os.put_int(1, 1);
+            os.align8();
+            ASSERT_EQ(os.tellp(), (start + 7) / 8 * 8);
+            coder::vbyte c;
+            c.encode(os, A.data(), A.size());
+        }
+        bit_istream<sdsl::bit_vector> is(bv);
+        for (size_t i = 0; i < start; i++)
+            ASSERT_EQ(is.get_int(1), 1ULL);
+        is.align8();
+        ASSERT_EQ(is.tellg(), (start + 7) / 8 * 8);
+        std::vector<uint32_t> B(A.size());
+        coder::vbyte c;
+        c.decode(is, B.data(), B.size());
+        ASSERT_EQ(B, A);
+    }
+}
+
+TEST(bit_stream, stream_vbyte)
+{
+    size_t n = 20;
+    std::mt19937 gen(4711);
+    std::uniform_int_distribution<uint64_t> dis(1, 10000);
+
+    for (size_t i = 0; i < n; i++) {
+        size_t len = dis(gen);
+        std::vector<uint32_t> A(len);
+        for (size_t j = 0; j < len; j++)
+            A[j] = gen() >> (8 * (gen() % 4)); // values of all byte lengths
+        coder::stream_vbyte c;
+        coder::vbyte v;
+        sdsl::bit_vector bv;
+        {
+            bit_ostream<sdsl::bit_vector> os(bv);
+            os.put_int(1, 3); // unaligned start
+            c.encode(os, A.data(), len);
+            v.encode_check_size(os, 4711U);
+        }
+        std::vector<uint32_t> B(len);
+        {
+            bit_istream<sdsl::bit_vector> is(bv);
+            is.get_int(3);
+            c.decode(is, B.data(), len);
+            ASSERT_EQ(v.decode(is), 4711ULL);
+        }
+        ASSERT_EQ(B, A);
+        {
+            bit_istream<sdsl::bit_vector> is(bv);
+            is.get_int(3);
+            c.skip(is, len);
+            ASSERT_EQ(v.decode(is), 4711ULL);
+        }
+    }
+}
+
+template <class t_coder>
+void check_fastpfor_coder()
+{
+    std::mt19937 gen(4711);
+    std::uniform_int_distribution<uint64_t> dis(0, 5000);
+    for (size_t i = 0; i < 20; i++) {
+        size_t len = dis(gen);
+        std::vector<uint32_t> A(len);
+        for (size_t j = 0; j < len; j++)
+            A[j] = gen() >> (gen() % 32);
+        t_coder c;
+        sdsl::bit_vector bv;
+        {
+            bit_ostream<sdsl::bit_vector> os(bv);
+            os.put_int(1, 5); // unaligned start
+            c.encode(os, A.data(), len);
+            c.encode(os, A.data(), len);
+        }
+        std::vector<uint32_t> B(len);
+        {
+            bit_istream<sdsl::bit_vector> is(bv);
+            is.get_int(5);
+            c.skip(is, len);
+            c.decode(is, B.data(), len);
+        }
+        ASSERT_EQ(B, A);
+    }
+}
+
+TEST(bit_stream, simd_bp128)
+{
+    check_fastpfor_coder<coder::simd_bp128>();
+}
+
+TEST(bit_stream, simd_fastpfor)
+{
+    check_fastpfor_coder<coder::simd_fastpfor>();
+}
+
 TEST(bit_stream, fixed)
 {
     size_t n = 20;
@@ -72,6 +192,50 @@ TEST(bit_stream, fixed)
     }
 }
 
+template <uint8_t t_width>
+void check_fixed_bulk()
+{
+    std::mt19937_64 gen(4711);
+    for (size_t i = 0; i < 10; i++) {
+        size_t len = gen() % 1000;
+        std::vector<uint64_t> A(len);
+        for (size_t j = 0; j < len; j++)
+            A[j] = gen() >> (64 - t_width);
+        coder::fixed<t_width> c;
+        sdsl::bit_vector bv;
+        {
+            bit_ostream<sdsl::bit_vector> os(bv);
+            os.put_int(1, i * 7 % 64); // all start offsets
+            c.encode(os, A.data(), len);
+            os.put_int(4711, 13);
+        }
+        std::vector<uint64_t> B(len);
+        {
+            bit_istream<sdsl::bit_vector> is(bv);
+            is.get_int(i * 7 % 64);
+            c.decode(is, B.data(), len);
+            ASSERT_EQ(is.get_int(13), 4711ULL);
+        }
+        ASSERT_EQ(B, A);
+        {
+            // the bulk format is plain bit packing
+            bit_istream<sdsl::bit_vector> is(bv);
+            is.get_int(i * 7 % 64);
+            for (size_t j = 0; j < len; j++)
+                ASSERT_EQ(is.get_int(t_width), A[j]);
+        }
+    }
+}
+
+TEST(bit_stream, fixed_bulk)
+{
+    check_fixed_bulk<1>();
+    check_fixed_bulk<7>();
+    check_fixed_bulk<24>();
+    check_fixed_bulk<33>();
+    check_fixed_bulk<64>();
+}
+
 TEST(bit_stream, aligned_fixed)
 {
     size_t n = 20;
@@ -189,6 +353,40 @@ TEST(bit_stream, zlib_uint8)
     }
 }
 
+TEST(bit_stream, zlib_primed)
+{
+    std::mt19937 gen(4711);
+    std::vector<uint8_t> dict(16 * 1024);
+    for (auto& x : dict)
+        x = gen();
+    // short inputs made of pieces of the dictionary
+    for (size_t i = 0; i < 20; i++) {
+        std::vector<uint8_t> A;
+        while (A.size() < 2000) {
+            auto start = gen() % (dict.size() - 64);
+            A.insert(A.end(), dict.begin() + start, dict.begin() + start + 8 + gen() % 56);
+        }
+        coder::zlib<9> plain, primed;
+        primed.prime(dict.data(), dict.size());
+        sdsl::bit_vector bv_plain, bv_primed;
+        {
+            bit_ostream<sdsl::bit_vector> os(bv_plain);
+            plain.encode(os, A.data(), A.size());
+        }
+        {
+            bit_ostream<sdsl::bit_vector> os(bv_primed);
+            primed.encode(os, A.data(), A.size());
+        }
+        ASSERT_LT(bv_primed.size() * 2, bv_plain.size());
+        std::vector<uint8_t> B(A.size());
+        {
+            bit_istream<sdsl::bit_vector> is(bv_primed);
+            primed.decode(is, B.data(), B.size());
+        }
+        ASSERT_EQ(A, B);
+    }
+}
+
 TEST(bit_stream, lz4_uint8)
 {
     size_t n = 20;
@@ -377,6 +575,1156 @@ TEST(bit_stream, lzma_uint8)
     }
 }
 
+/*
+    encodes random blocks of literal runs, dictionary factors and (with
+    local search) factors copied from the block itself, and checks that
+    the fused decoder writes the same text as decoding the factors and
+    then copying them.
+ */
+template <class t_coder, bool t_local, class t_copy_policy>
+void check_fused_decoding(std::mt19937& gen)
+{
+    static_assert(t_coder::fused_decoding, "coder does not use fused decoding");
+    const size_t block_size = 4096;
+    const size_t threshold = t_coder::literal_threshold;
+    std::vector<uint8_t> dict(10000);
+    for (auto& x : dict)
+        x = gen();
+    t_coder coder;
+    for (size_t r = 0; r < 50; r++) {
+        size_t text_len = (r < 2) ? r + 1 : gen() % block_size + 1;
+        std::vector<uint8_t> text;
+        block_factor_data bfd(block_size, factor_layout::of<t_coder>());
+        while (text.size() < text_len) {
+            size_t left = text_len - text.size();
+            auto kind = gen() % 3;
+            std::vector<uint8_t> factor;
+            uint32_t offset = 0;
+            if (kind == 0 || left <= threshold) {
+                factor.resize(std::min<size_t>(gen() % threshold + 1, left));
+                for (auto& x : factor)
+                    x = gen();
+            }
+            else if (kind == 1 || !t_local || text.size() <= threshold) {
+                size_t len = threshold + 1 + gen() % std::min<size_t>(left - threshold, 100);
+                size_t dict_offset = gen() % (dict.size() - len + 1);
+                factor.assign(dict.begin() + dict_offset, dict.begin() + dict_offset + len);
+                offset = t_local ? block_size + dict_offset : dict_offset;
+            }
+            else {
+                size_t len = threshold + 1 + gen() % (std::min<size_t>(std::min(left, text.size()), 100) - threshold);
+                offset = gen() % (text.size() - len + 1);
+                factor.assign(text.begin() + offset, text.begin() + offset + len);
+            }
+            text.insert(text.end(), factor.begin(), factor.end());
+            bfd.add_factor(coder, factor.begin(), offset, factor.size());
+        }
+        auto num_factors = bfd.num_factors;
+        sdsl::bit_vector bv;
+        {
+            block_factor_data tmp(bfd);
+            bit_ostream<sdsl::bit_vector> os(bv);
+            os.put_int(5, 3);
+            coder.encode_block(os, tmp);
+        }
+
+        /* decode the factors, then copy */
+        block_factor_data decoded(block_size, factor_layout::of<t_coder>());
+        bit_istream<sdsl::bit_vector> is(bv);
+        is.get_int(3);
+        coder.decode_block(is, decoded, num_factors);
+        std::vector<uint8_t> expected;
+        size_t literals_used = 0, offsets_used = 0;
+        for (size_t i = 0; i < num_factors; i++) {
+            auto len = decoded.lengths[i];
+            if (len <= threshold) {
+                expected.insert(expected.end(), decoded.literals.begin() + literals_used,
+                    decoded.literals.begin() + literals_used + len);
+                literals_used += len;
+            }
+            else {
+                auto offset = decoded.offsets[offsets_used++];
+                if (t_local && offset < block_size) {
+                    std::vector<uint8_t> local(expected.begin() + offset, expected.begin() + offset + len);
+                    expected.insert(expected.end(), local.begin(), local.end());
+                }
+                else {
+                    auto begin = dict.begin() + (t_local ? offset - block_size : offset);
+                    expected.insert(expected.end(), begin, begin + len);
+                }
+            }
+        }
+        ASSERT_EQ(expected, text);
+
+        /* fused, reusing the decoded factors as scratch */
+        std::vector<uint8_t> out(block_size);
+        bit_istream<sdsl::bit_vector> fis(bv);
+        fis.get_int(3);
+        auto written = coder.template decode_block_text<t_local, t_copy_policy>(fis, decoded, num_factors,
+            dict.data(), dict.size(), block_size, out.data(), out.data() + out.size());
+        ASSERT_EQ(written, expected.size());
+        ASSERT_TRUE(std::equal(expected.begin(), expected.end(), out.begin()));
+        ASSERT_EQ(fis.tellg(), is.tellg());
+        ASSERT_EQ(decoded.num_factors, num_factors);
+    }
+}
+
+template <class t_coder>
+void check_fused_decoding_policies(std::mt19937& gen)
+{
+    check_fused_decoding<t_coder, false, copy_std>(gen);
+    check_fused_decoding<t_coder, false, copy_wild>(gen);
+    check_fused_decoding<t_coder, true, copy_std>(gen);
+    check_fused_decoding<t_coder, true, copy_wild>(gen);
+}
+
+TEST(factor_data, default_counts)
+{
+    block_factor_data bfd;
+    ASSERT_EQ(bfd.num_factors, 0ULL);
+    ASSERT_EQ(bfd.num_literals, 0ULL);
+    ASSERT_EQ(bfd.num_offsets, 0ULL);
+    ASSERT_EQ(bfd.num_offset_literals, 0ULL);
+    ASSERT_FALSE(bfd.last_factor_was_literal);
+    block_factor_data copy(bfd);
+    ASSERT_EQ(copy.num_factors, 0ULL);
+    ASSERT_FALSE(copy.last_factor_was_literal);
+}
+
+TEST(factor_coder, fused_decoding)
+{
+    std::mt19937 gen(4711);
+    check_fused_decoding_policies<factor_coder_blocked<> >(gen);
+    check_fused_decoding_policies<factor_coder_blocked<3, coder::aligned_fixed<uint8_t>, coder::aligned_fixed<uint32_t>, coder::vbyte> >(gen);
+    check_fused_decoding_policies<factor_coder_blocked<3, coder::vbyte, coder::vbyte, coder::vbyte> >(gen);
+    check_fused_decoding_policies<factor_coder_blocked<2, coder::fixed<8>, coder::fixed<32>, coder::aligned_fixed<uint32_t> > >(gen);
+    check_fused_decoding_policies<factor_coder_blocked<5, coder::aligned_fixed<uint8_t>, coder::vbyte, coder::fixed<13> > >(gen);
+}
+
+TEST(factor_coder, rans)
+{
+    const size_t block_size = 4096;
+    std::mt19937 gen(4711);
+    factor_coder_rans<3, 4> c;
+    auto make_block = [&](block_factor_data& bfd, uint32_t max_offset) {
+        bfd.reset();
+        std::vector<uint8_t> text(block_size);
+        for (auto& x : text)
+            x = 'a' + gen() % 8;
+        size_t pos = 0;
+        while (pos < block_size) {
+            uint32_t len = std::min<uint32_t>(block_size - pos, 1 + (gen() % 4 == 0 ? gen() % 300 : gen() % 6));
+            bfd.add_factor(c, text.begin() + pos, gen() % max_offset, len);
+            pos += len;
+        }
+    };
+    rans_factor_model model;
+    block_factor_data bfd(block_size, factor_layout::of<decltype(c)>());
+    for (size_t i = 0; i < 10; i++) {
+        make_block(bfd, 1 << 20);
+        model.count(bfd);
+    }
+    model.build();
+    std::stringstream ss;
+    model.serialize(ss);
+    std::shared_ptr<rans_factor_model> loaded(new rans_factor_model());
+    loaded->load(ss);
+    c.use_model(loaded);
+    ASSERT_EQ(loaded->literals.freq('a'), model.literals.freq('a'));
+    ASSERT_EQ(loaded->literals.freq('z'), 1U);
+
+    // offsets far larger than any seen in training still round trip
+    for (uint32_t max_offset : { 1U << 20, 1U << 31 }) {
+        make_block(bfd, max_offset);
+        block_factor_data expected(bfd);
+        sdsl::bit_vector bv;
+        {
+            bit_ostream<sdsl::bit_vector> os(bv);
+            os.put_int(5, 3);
+            c.encode_block(os, bfd);
+        }
+        block_factor_data decoded(block_size, factor_layout::of<decltype(c)>());
+        bit_istream<sdsl::bit_vector> is(bv);
+        is.get_int(3);
+        c.decode_block(is, decoded, expected.num_factors);
+        ASSERT_EQ(decoded.num_literals, expected.num_literals);
+        ASSERT_EQ(decoded.num_offsets, expected.num_offsets);
+        for (size_t i = 0; i < expected.num_factors; i++)
+            ASSERT_EQ(decoded.lengths[i], expected.lengths[i]);
+        for (size_t i = 0; i < expected.num_literals; i++)
+            ASSERT_EQ(decoded.literals[i], expected.literals[i]);
+        for (size_t i = 0; i < expected.num_offsets; i++)
+            ASSERT_EQ(decoded.offsets[i], expected.offsets[i]);
+        ASSERT_EQ(is.tellg(), bv.size());
+    }
+}
+
+/* a block of random factors with short literal runs and long copies */
+template <class t_coder>
+void make_twostream_block(const t_coder& c, block_factor_data& bfd, size_t block_size, std::mt19937& gen)
+{
+    bfd.reset();
+    std::vector<uint8_t> text(block_size);
+    for (auto& x : text)
+        x = 'a' + gen() % 8;
+    size_t pos = 0;
+    while (pos < block_size) {
+        uint32_t len = std::min<uint32_t>(block_size - pos, 1 + (gen() % 4 == 0 ? gen() % 300 : gen() % 6));
+        bfd.add_factor(c, text.begin() + pos, gen() % (1 << 20), len);
+        pos += len;
+    }
+}
+
+/* encode_block, then decode_block and decode_lengths give back the factors */
+template <class t_coder>
+void check_twostream_roundtrip(const t_coder& c, size_t block_size, std::mt19937& gen)
+{
+    block_factor_data bfd(block_size, factor_layout::of<t_coder>());
+    for (size_t i = 0; i < 5; i++) {
+        make_twostream_block(c, bfd, block_size, gen);
+        block_factor_data expected(bfd);
+        sdsl::bit_vector bv;
+        {
+            bit_ostream<sdsl::bit_vector> os(bv);
+            os.put_int(5, 3);
+            c.encode_block(os, bfd);
+        }
+        for (int lengths_only = 0; lengths_only < 2; lengths_only++) {
+            block_factor_data decoded(block_size, factor_layout::of<t_coder>());
+            bit_istream<sdsl::bit_vector> is(bv);
+            is.get_int(3);
+            if (lengths_only)
+                c.decode_lengths(is, decoded, expected.num_factors);
+            else
+                c.decode_block(is, decoded, expected.num_factors);
+            ASSERT_EQ(decoded.num_literals, expected.num_literals);
+            ASSERT_EQ(decoded.num_offsets, expected.num_offsets);
+            ASSERT_EQ(decoded.num_offset_literals, expected.num_offset_literals);
+            for (size_t j = 0; j < expected.num_factors; j++)
+                ASSERT_EQ(decoded.lengths[j], expected.lengths[j]);
+            for (size_t j = 0; j < expected.num_literals; j++)
+                ASSERT_EQ(decoded.literals[j], expected.literals[j]);
+            for (size_t j = 0; j < expected.num_offsets; j++)
+                ASSERT_EQ(decoded.offsets[j], expected.offsets[j]);
+            ASSERT_EQ(is.tellg(), bv.size());
+        }
+    }
+}
+
+template <uint32_t t_literal_threshold>
+void check_primed_coder()
+{
+    const size_t block_size = 4096;
+    std::mt19937 gen(4711);
+    factor_coder_blocked_twostream_primed<t_literal_threshold, coder::zlib<9>, coder::zlib<9>, 4096> c;
+    using model_type = typename decltype(c)::model_type;
+    block_factor_data bfd(block_size, factor_layout::of<decltype(c)>());
+    make_twostream_block(c, bfd, block_size, gen);
+    {
+        sdsl::bit_vector bv;
+        bit_ostream<sdsl::bit_vector> os(bv);
+        ASSERT_THROW(c.encode_block(os, bfd), std::runtime_error);
+    }
+    model_type model;
+    for (size_t i = 0; i < 10; i++) {
+        make_twostream_block(c, bfd, block_size, gen);
+        model.count(bfd);
+    }
+    model.build();
+    ASSERT_GT(model.lengths.size(), 0ULL);
+    ASSERT_GT(model.offset_literals.size(), 0ULL);
+    std::stringstream ss;
+    model.serialize(ss);
+    std::shared_ptr<model_type> loaded(new model_type());
+    loaded->load(ss);
+    c.use_model(loaded);
+    check_twostream_roundtrip(c, block_size, gen);
+}
+
+TEST(factor_coder, twostream)
+{
+    std::mt19937 gen(4711);
+    check_twostream_roundtrip(factor_coder_blocked_twostream<1, coder::aligned_fixed<uint32_t>, coder::vbyte>(), 4096, gen);
+    check_twostream_roundtrip(factor_coder_blocked_twostream<3, coder::aligned_fixed<uint32_t>, coder::vbyte>(), 4096, gen);
+    check_twostream_roundtrip(factor_coder_blocked_twostream<3, coder::zlib<9>, coder::zlib<9> >(), 4096, gen);
+}
+
+TEST(factor_coder, twostream_primed)
+{
+    check_primed_coder<1>();
+    check_primed_coder<3>();
+}
+
+/* a text of n bytes in blocks of 16 which hands out decoded blocks in reverse order */
+struct reversing_block_source {
+    static const uint64_t block_size = 16;
+    struct context_type {
+    };
+    size_t n;
+    mutable std::vector<size_t> decodes;
+
+    reversing_block_source(size_t text_size)
+        : n(text_size)
+        , decodes((text_size + block_size - 1) / block_size)
+    {
+    }
+    size_t size() const
+    {
+        return n;
+    }
+    uint8_t at(size_t i) const
+    {
+        return (i * 7 + 3) & 0xFF;
+    }
+    context_type create_context() const
+    {
+        return context_type();
+    }
+    void prefetch_blocks(const std::vector<uint64_t>&) const
+    {
+    }
+    template <class t_fn>
+    void decode_blocks(context_type&, const std::vector<uint64_t>& block_ids, std::vector<uint8_t>& text, t_fn&& fn) const
+    {
+        for (size_t k = block_ids.size(); k-- > 0;) {
+            auto beg = block_ids[k] * block_size;
+            auto len = std::min<size_t>(block_size, n - beg);
+            for (size_t i = 0; i < len; i++)
+                text[i] = at(beg + i);
+            decodes[block_ids[k]]++;
+            fn(k, text.data(), len);
+        }
+    }
+};
+
+TEST(batch_extract, split_and_reorder)
+{
+    reversing_block_source src(1000);
+    std::vector<text_range> ranges = { { 0, 1000 }, { 5, 3 }, { 990, 10 }, { 15, 2 }, { 100, 0 }, { 500, 64 }, { 510, 40 } };
+    std::vector<std::vector<uint8_t> > bufs(ranges.size());
+    std::vector<uint8_t*> out;
+    for (size_t i = 0; i < ranges.size(); i++) {
+        bufs[i].resize(ranges[i].length);
+        out.push_back(bufs[i].data());
+    }
+    extract_batch(src, ranges, out);
+    for (size_t i = 0; i < ranges.size(); i++) {
+        for (size_t j = 0; j < ranges[i].length; j++)
+            ASSERT_EQ(bufs[i][j], src.at(ranges[i].offset + j));
+    }
+    // every block is decoded once even though the ranges overlap
+    for (auto d : src.decodes)
+        ASSERT_EQ(d, 1ULL);
+}
+
+TEST(batch_extract, bounds)
+{
+    reversing_block_source src(1000);
+    std::vector<uint8_t> buf(16);
+    std::vector<uint8_t*> out = { buf.data() };
+    ASSERT_THROW(extract_batch(src, { { 990, 11 } }, out), std::out_of_range);
+    ASSERT_THROW(extract_batch(src, { { 8, std::numeric_limits<uint64_t>::max() - 4 } }, out), std::out_of_range);
+    ASSERT_THROW(extract_batch(src, { { 0, 1 }, { 1, 1 } }, out), std::invalid_argument);
+}
+
+/* a collection of random words and DOCNO tags in the working directory, written on first use */
+collection& test_collection()
+{
+    static std::unique_ptr<collection> col;
+    if (!col) {
+        std::string dir = "unit_test_collection";
+        utils::create_directory(dir);
+        std::vector<std::string> words = { "the ", "quick ", "brown ", "fox ", "jumps ", "over ", "lazy ", "dog ", "ulysses ", "stately ", "plump " };
+        std::mt19937 gen(4711);
+        sdsl::int_vector<8> text;
+        std::ofstream dof(dir + "/" + KEY_PREFIX + KEY_DOCORDER);
+        size_t num_docs = 0;
+        while (text.size() < 100000) {
+            std::string w = words[gen() % words.size()];
+            if (gen() % 7 == 0)
+                w += (char)('A' + gen() % 26);
+            if (text.size() == 0 || gen() % 50 == 0) {
+                std::string docno = "D" + std::to_string(num_docs++);
+                dof << docno << " " << text.size() << "\n";
+                w = "<DOCNO>" + docno + "</DOCNO>\n";
+            }
+            for (auto c : w)
+                text.push_back((uint8_t)c);
+        }
+        dof.close();
+        sdsl::store_to_file(text, dir + "/" + KEY_PREFIX + KEY_TEXT);
+        col.reset(new collection(dir));
+    }
+    return *col;
+}
+
+template <class t_coder, bool t_local = false>
+using test_store = rlz_store_static<dict_uniform_sample_budget<256>, dict_prune_none, dict_index_csa<>, 4096, t_local,
+    factor_select_first, t_coder, block_map_uncompressed>;
+using test_coder = factor_coder_blocked<3, coder::aligned_fixed<uint8_t>, coder::aligned_fixed<uint32_t>, coder::vbyte>;
+
+std::vector<uint8_t> test_text()
+{
+    const sdsl::int_vector_mapper<8, std::ios_base::in> text(test_collection().file_map[KEY_TEXT]);
+    return std::vector<uint8_t>(text.begin(), text.end());
+}
+
+template <class t_store>
+void check_store_move(std::unique_ptr<t_store> moved_from, const std::vector<uint8_t>& text)
+{
+    // the first call caches a decode context for the store in this thread
+    auto block = moved_from->block(3);
+    ASSERT_TRUE(std::equal(block.begin(), block.end(), text.begin() + 3 * t_store::block_size));
+    auto old_id = moved_from->store_id();
+    t_store store(std::move(*moved_from));
+    ASSERT_NE(store.store_id(), old_id);
+    ASSERT_NE(moved_from->store_id(), old_id);
+    ASSERT_NE(&store.block_map, &moved_from->block_map);
+    moved_from.reset();
+    ASSERT_EQ(store.block(3), block);
+    ASSERT_EQ(store.block_map.num_blocks(), (text.size() + t_store::block_size - 1) / t_store::block_size);
+
+    // move assignment
+    std::unique_ptr<t_store> other(new t_store(std::move(store)));
+    auto assigned_id = store.store_id();
+    other->block(5);
+    store = std::move(*other);
+    ASSERT_NE(store.store_id(), assigned_id);
+    other.reset();
+    ASSERT_EQ(store.block(3), block);
+    auto block5 = store.block(5);
+    ASSERT_TRUE(std::equal(block5.begin(), block5.end(), text.begin() + 5 * t_store::block_size));
+}
+
+TEST(decode_context, store_move)
+{
+    auto text = test_text();
+    using store_type = test_store<test_coder>;
+    check_store_move(std::unique_ptr<store_type>(new store_type(
+                         store_type::builder{}.set_dict_size(8 * 1024).build_or_load(test_collection()))),
+        text);
+    using lz_type = lz_store_static<coder::zlib<9>, 4096>;
+    check_store_move(std::unique_ptr<lz_type>(new lz_type(lz_type::builder{}.build_or_load(test_collection()))), text);
+}
+
+TEST(factor_skip_index, checkpoints)
+{
+    using store_type = test_store<test_coder>;
+    auto store = store_type::builder{}.set_rebuild(true).set_dict_size(8 * 1024).build_or_load(test_collection());
+    const uint64_t sample_rate = 16;
+    factor_skip_index si(store, sample_rate);
+    auto ctx = store.create_context();
+    for (size_t block_id = 0; block_id < store.block_map.num_blocks(); block_id++) {
+        auto num_factors = store.block_map.block_factors(block_id);
+        store.seek_block(ctx, block_id);
+        ctx.coder.decode_lengths(ctx.stream, ctx.bfd, num_factors);
+        // the checkpoint of every text position is the last sampled factor starting at or before it
+        uint64_t text_pos = 0, literal_pos = 0, offset_pos = 0;
+        factor_skip_index::checkpoint expected = { 0, 0, 0, 0 };
+        for (size_t i = 0; i < num_factors; i++) {
+            if (i % sample_rate == 0)
+                expected = { i, text_pos, literal_pos, offset_pos };
+            auto len = ctx.bfd.lengths[i];
+            for (uint64_t p = text_pos; p < text_pos + len; p++) {
+                auto cp = si.find(block_id, p);
+                ASSERT_EQ(cp.factor, expected.factor);
+                ASSERT_EQ(cp.text_pos, expected.text_pos);
+                ASSERT_EQ(cp.literal_pos, expected.literal_pos);
+                ASSERT_EQ(cp.offset_pos, expected.offset_pos);
+            }
+            if (len <= test_coder::literal_threshold)
+                literal_pos += len;
+            else
+                offset_pos++;
+            text_pos += len;
+        }
+        ASSERT_EQ(text_pos, store.block_length(block_id));
+    }
+    std::stringstream ss;
+    si.serialize(ss);
+    factor_skip_index loaded;
+    loaded.load(ss);
+    ASSERT_EQ(loaded.m_sample_rate, sample_rate);
+    ASSERT_EQ(loaded.m_text_pos.size(), si.m_text_pos.size());
+    for (size_t i = 0; i < si.m_text_pos.size(); i++)
+        ASSERT_EQ(loaded.m_text_pos[i], si.m_text_pos[i]);
+}
+
+TEST(factor_skip_index, decode_range)
+{
+    using store_type = test_store<test_coder>;
+    auto store = store_type::builder{}.set_dict_size(8 * 1024).set_skip_index(true).build_or_load(test_collection());
+    ASSERT_TRUE(store.has_skip_index());
+    auto text = test_text();
+    factor_skip_index si(store);
+    auto ctx = store.create_context();
+    std::vector<uint8_t> out(store_type::block_size);
+    std::mt19937 gen(4711);
+    for (size_t block_id = 0; block_id < store.block_map.num_blocks(); block_id++) {
+        auto block_beg = block_id * store_type::block_size;
+        auto block_len = store.block_length(block_id);
+        // ranges starting, ending and straddling at each checkpoint
+        std::vector<std::pair<uint64_t, uint64_t> > ranges = { { 0, block_len }, { block_len - 1, 1 } };
+        for (uint64_t p = 0; p < block_len; p++) {
+            auto cp = si.find(block_id, p);
+            if (cp.text_pos == p && p > 0) {
+                ranges.push_back({ p, 1 });
+                ranges.push_back({ p - 1, 2 });
+                ranges.push_back({ p - 1, block_len - p + 1 });
+                ranges.push_back({ gen() % p, gen() % (block_len - p) + 1 });
+            }
+        }
+        for (const auto& r : ranges) {
+            auto len = store.decode_range(ctx, block_id, r.first, r.second, out.data());
+            ASSERT_EQ(len, r.second);
+            for (size_t i = 0; i < len; i++)
+                ASSERT_EQ(out[i], text[block_beg + r.first + i]);
+        }
+        // ranges past the end of the block are cut
+        ASSERT_EQ(store.decode_range(ctx, block_id, block_len - 3, 10, out.data()), 3ULL);
+    }
+    std::vector<uint8_t> all(text.size());
+    ASSERT_EQ(store.extract(ctx, 0, text.size(), all.data()), text.size());
+    ASSERT_EQ(all, text);
+}
+
+TEST(factor_skip_index, decode_range_local)
+{
+    using store_type = test_store<test_coder, true>;
+    auto store = store_type::builder{}.set_dict_size(8 * 1024).build_or_load(test_collection());
+    auto text = test_text();
+    auto ctx = store.create_context();
+    std::vector<uint8_t> out(store_type::block_size);
+    for (size_t block_id = 0; block_id < store.block_map.num_blocks(); block_id++) {
+        auto block_beg = block_id * store_type::block_size;
+        auto len = store.decode_range(ctx, block_id, 100, 1000, out.data());
+        ASSERT_EQ(len, std::min<uint64_t>(1000, store.block_length(block_id) - 100));
+        for (size_t i = 0; i < len; i++)
+            ASSERT_EQ(out[i], text[block_beg + 100 + i]);
+    }
+    // the block buffer of the context is reused
+    ASSERT_EQ(ctx.text.size(), store_type::block_size);
+}
+
+TEST(factor_skip_index, decode_range_twostream)
+{
+    // coders that cannot skip decode the whole block for a range
+    using store_type = test_store<factor_coder_blocked_twostream<1, coder::aligned_fixed<uint32_t>, coder::vbyte> >;
+    auto store = store_type::builder{}.set_dict_size(8 * 1024).set_skip_index(true).build_or_load(test_collection());
+    ASSERT_TRUE(store.has_skip_index());
+    auto text = test_text();
+    auto ctx = store.create_context();
+    std::vector<uint8_t> out(store_type::block_size);
+    for (size_t block_id = 0; block_id < store.block_map.num_blocks(); block_id++) {
+        auto block_beg = block_id * store_type::block_size;
+        auto len = store.decode_range(ctx, block_id, 100, 1000, out.data());
+        ASSERT_EQ(len, std::min<uint64_t>(1000, store.block_length(block_id) - 100));
+        for (size_t i = 0; i < len; i++)
+            ASSERT_EQ(out[i], text[block_beg + 100 + i]);
+    }
+}
+
+TEST(block_cache, hit_miss)
+{
+    block_cache cache(1024, 1);
+    std::vector<uint8_t> A(100);
+    for (size_t i = 0; i < A.size(); i++)
+        A[i] = i;
+    ASSERT_TRUE(cache.find(5) == nullptr);
+    ASSERT_TRUE(cache.insert(5, A.data(), A.size()));
+    auto B = cache.find(5);
+    ASSERT_TRUE(B != nullptr);
+    ASSERT_EQ(B->size(), A.size());
+    for (size_t i = 0; i < A.size(); i++) {
+        ASSERT_EQ((*B)[i], A[i]);
+    }
+    auto stats = cache.stats();
+    ASSERT_EQ(stats.hits, 1ULL);
+    ASSERT_EQ(stats.misses, 1ULL);
+    ASSERT_EQ(stats.cached_blocks, 1ULL);
+    ASSERT_EQ(stats.cached_bytes, A.size());
+}
+
+TEST(block_cache, capacity)
+{
+    size_t capacity = 4096;
+    block_cache cache(capacity, 4);
+    std::mt19937 gen(4711);
+    std::uniform_int_distribution<uint64_t> dis(0, 200);
+    std::vector<uint8_t> A(256);
+    for (size_t i = 0; i < 10000; i++) {
+        auto id = dis(gen);
+        if (cache.find(id) == nullptr)
+            cache.insert(id, A.data(), A.size());
+        ASSERT_TRUE(cache.stats().cached_bytes <= capacity);
+    }
+    ASSERT_TRUE(cache.stats().evictions > 0);
+}
+
+TEST(block_cache, scan_resistance)
+{
+    block_cache cache(10 * 100, 1);
+    std::vector<uint8_t> A(100);
+    // make a small working set popular
+    for (size_t r = 0; r < 10; r++) {
+        for (uint64_t id = 0; id < 10; id++) {
+            if (cache.find(id) == nullptr)
+                cache.insert(id, A.data(), A.size());
+        }
+    }
+    // a single pass over cold blocks should not displace it
+    for (uint64_t id = 1000; id < 2000; id++) {
+        if (cache.find(id) == nullptr)
+            cache.insert(id, A.data(), A.size());
+    }
+    size_t hits = 0;
+    for (uint64_t id = 0; id < 10; id++) {
+        if (cache.find(id) != nullptr)
+            hits++;
+    }
+    ASSERT_EQ(hits, 10ULL);
+}
+
+TEST(text_segments, merge_and_finalize)
+{
+    std::vector<uint8_t> dict(1000);
+    for (size_t i = 0; i < dict.size(); i++)
+        dict[i] = i;
+    std::vector<uint8_t> literals = { 'a', 'b', 'c' };
+    text_segments segs;
+    segs.add_external(dict.data() + 10, 20);
+    segs.add_external(dict.data() + 30, 5); // contiguous, merged
+    segs.add_owned(literals.data(), 2);
+    segs.add_owned(literals.data() + 2, 1); // adjacent literals, merged
+    segs.add_external(dict.data() + 500, 7);
+    segs.finalize();
+    ASSERT_EQ(segs.num_segments(), 3ULL);
+    ASSERT_EQ(segs.size(), 35ULL);
+    std::vector<uint8_t> expected(dict.begin() + 10, dict.begin() + 35);
+    expected.insert(expected.end(), literals.begin(), literals.end());
+    expected.insert(expected.end(), dict.begin() + 500, dict.begin() + 507);
+    std::vector<uint8_t> gathered;
+    for (size_t i = 0; i < segs.num_segments(); i++) {
+        auto ptr = (const uint8_t*)segs.iov()[i].iov_base;
+        gathered.insert(gathered.end(), ptr, ptr + segs.iov()[i].iov_len);
+    }
+    ASSERT_EQ(gathered, expected);
+}
+
+template <class t_store>
+void check_extract_segments(const t_store& store, const std::vector<uint8_t>& text)
+{
+    auto ctx = store.create_context();
+    text_segments segs;
+    std::mt19937 gen(4711);
+    for (size_t r = 0; r < 100; r++) {
+        uint64_t offset = gen() % text.size();
+        uint64_t len = gen() % (3 * t_store::block_size);
+        auto n = store.extract_segments(ctx, offset, len, segs);
+        ASSERT_EQ(n, std::min<uint64_t>(len, text.size() - offset));
+        std::vector<uint8_t> gathered;
+        for (size_t i = 0; i < segs.num_segments(); i++) {
+            auto ptr = (const uint8_t*)segs.iov()[i].iov_base;
+            gathered.insert(gathered.end(), ptr, ptr + segs.iov()[i].iov_len);
+        }
+        ASSERT_TRUE(std::equal(gathered.begin(), gathered.end(), text.begin() + offset));
+    }
+}
+
+TEST(text_segments, extract_segments)
+{
+    auto text = test_text();
+    auto store = test_store<test_coder>::builder{}.set_dict_size(8 * 1024).build_or_load(test_collection());
+    check_extract_segments(store, text);
+    auto local_store = test_store<test_coder, true>::builder{}.set_dict_size(8 * 1024).build_or_load(test_collection());
+    check_extract_segments(local_store, text);
+}
+
+TEST(docno_index, documents)
+{
+    auto text = test_text();
+    auto store = test_store<test_coder>::builder{}.set_dict_size(8 * 1024).build_or_load(test_collection());
+    const auto& docs = store.documents();
+    ASSERT_GT(docs.num_docs(), 100ULL);
+    uint64_t prev_end = 0;
+    for (uint64_t doc_id = 0; doc_id < docs.num_docs(); doc_id++) {
+        auto docno = docs.docno(doc_id);
+        ASSERT_EQ(docno, "D" + std::to_string(doc_id));
+        ASSERT_EQ(docs.doc_id(docno), doc_id);
+        auto range = docs.doc_range(doc_id);
+        ASSERT_EQ(range.first, prev_end);
+        ASSERT_LT(range.first, range.second);
+        prev_end = range.second;
+        std::string tag = "<DOCNO>" + docno + "</DOCNO>";
+        ASSERT_TRUE(std::equal(tag.begin(), tag.end(), text.begin() + range.first));
+
+        std::vector<uint8_t> expected(text.begin() + range.first, text.begin() + range.second);
+        ASSERT_EQ(store.get_document(doc_id, 2), expected);
+        ASSERT_EQ(store.get_document(docno), expected);
+    }
+    // the last document ends with the text
+    ASSERT_EQ(prev_end, text.size());
+    ASSERT_EQ(docs.doc_id("D"), docs.num_docs());
+    ASSERT_EQ(docs.doc_id("E0"), docs.num_docs());
+    ASSERT_THROW(store.get_document("D" + std::to_string(docs.num_docs())), std::out_of_range);
+    ASSERT_THROW(store.get_document(docs.num_docs()), std::out_of_range);
+}
+
+TEST(docno_index, malformed_docorder)
+{
+    std::string dir = "unit_test_docorder";
+    utils::create_directory(dir);
+    sdsl::int_vector<8> text(100, 'a');
+    sdsl::store_to_file(text, dir + "/" + KEY_PREFIX + KEY_TEXT);
+    auto build = [&](const std::string& docorder) {
+        {
+            std::ofstream dof(dir + "/" + KEY_PREFIX + KEY_DOCORDER);
+            dof << docorder;
+        }
+        collection col(dir);
+        return docno_index(col);
+    };
+    ASSERT_EQ(build("D1 0\nD2 10\n\nD3 50").num_docs(), 3ULL);
+    ASSERT_THROW(build("D1 0\nD2\nD3 50\n"), std::runtime_error);
+    ASSERT_THROW(build("D1 0\nD2 10\nD3"), std::runtime_error);
+    ASSERT_THROW(build("D1 0\nD2 x\n"), std::runtime_error);
+    ASSERT_THROW(build("D1 0\nD2 10 20\n"), std::runtime_error);
+    ASSERT_THROW(build("D1 10\nD2 10\n"), std::runtime_error);
+    ASSERT_THROW(build("D1 10\nD2 5\n"), std::runtime_error);
+    ASSERT_THROW(build("D1 0\nD2 100\n"), std::runtime_error);
+    try {
+        build("D1 0\nD2 10\nD3 x\n");
+        FAIL();
+    }
+    catch (const std::runtime_error& e) {
+        ASSERT_NE(std::string(e.what()).find("line 3"), std::string::npos);
+    }
+}
+
+TEST(store_manifest, relative_files)
+{
+    collection col = test_collection();
+    col.file_map["DIR"] = col.path;
+    col.file_map["DIRSLASH"] = col.path + "/";
+    col.file_map["ABS"] = "/tmp";
+    store_manifest m(col, "test_store", 4096, { KEY_TEXT, "DIR", "DIRSLASH", "ABS", "MISSING" });
+    ASSERT_EQ(m.get("file." + KEY_TEXT), KEY_PREFIX + KEY_TEXT);
+    ASSERT_EQ(m.get("file.DIR"), "");
+    ASSERT_EQ(m.get("file.DIRSLASH"), "");
+    ASSERT_EQ(m.get("file.ABS"), "/tmp");
+    ASSERT_FALSE(m.has("file.MISSING"));
+
+    auto parsed = store_manifest::parse(m.str());
+    parsed.check("test_store", 4096);
+    ASSERT_THROW(parsed.check("other_store", 4096), std::runtime_error);
+    collection loaded = test_collection();
+    loaded.file_map.clear();
+    parsed.apply(loaded);
+    ASSERT_EQ(loaded.file_map[KEY_TEXT], col.path + KEY_PREFIX + KEY_TEXT);
+    ASSERT_EQ(loaded.file_map["DIR"], col.path);
+    ASSERT_EQ(loaded.param_map[PARAM_TEXT_SIZE], std::to_string(col.text_size()));
+}
+
+/* blocks of varying size which take varying time to decode, optionally failing or corrupted */
+struct slow_block_source {
+    static const uint64_t block_size = 64;
+    struct context_type {
+    };
+    struct map_type {
+        size_t blocks;
+        size_t num_blocks() const
+        {
+            return blocks;
+        }
+    };
+    map_type block_map;
+    size_t failing_block;
+    mutable bool sequential = false;
+
+    slow_block_source(size_t num_blocks, size_t failing = std::numeric_limits<size_t>::max())
+        : block_map{ num_blocks }
+        , failing_block(failing)
+    {
+    }
+    static uint8_t at(size_t pos)
+    {
+        return (pos * 13 + 1) & 0xFF;
+    }
+    static size_t length(size_t block_id)
+    {
+        return block_size - block_id % 3;
+    }
+    context_type create_context() const
+    {
+        return context_type();
+    }
+    void prefetch_blocks(const std::vector<uint64_t>&) const
+    {
+    }
+    void sequential_access(bool s) const
+    {
+        sequential = s;
+    }
+    uint64_t decode_block(context_type&, uint64_t block_id, std::vector<uint8_t>& text) const
+    {
+        if (block_id == failing_block)
+            throw std::runtime_error("decode failed");
+        std::this_thread::sleep_for(std::chrono::microseconds((block_id * 7919) % 200));
+        for (size_t i = 0; i < length(block_id); i++)
+            text[i] = at(block_id * block_size + i);
+        return length(block_id);
+    }
+};
+
+TEST(parallel_decode, order)
+{
+    slow_block_source src(300);
+    for (size_t threads : { 0, 1, 2, 4, 8 }) {
+        for (size_t window : { 0, 1, 8, 64 }) {
+            size_t expected = 5;
+            parallel_decode(src, threads, [&](size_t block_id, const uint8_t* data, size_t size) {
+                ASSERT_EQ(block_id, expected);
+                ASSERT_EQ(size, slow_block_source::length(block_id));
+                for (size_t i = 0; i < size; i++)
+                    ASSERT_EQ(data[i], slow_block_source::at(block_id * slow_block_source::block_size + i));
+                expected++;
+            }, 5, 250, window);
+            ASSERT_EQ(expected, 250ULL);
+        }
+    }
+    size_t blocks = 0;
+    parallel_decode(src, 4, [&](size_t, const uint8_t*, size_t) { blocks++; });
+    ASSERT_EQ(blocks, 300ULL);
+    ASSERT_FALSE(src.sequential);
+}
+
+TEST(parallel_decode, exceptions)
+{
+    for (size_t threads : { 1, 4 }) {
+        // a failing decode ends the run. the blocks consumed before are in order,
+        // and with a single thread all blocks before the failing one are consumed
+        slow_block_source failing(300, 100);
+        size_t expected = 0;
+        auto consume = [&](size_t block_id, const uint8_t*, size_t) {
+            ASSERT_EQ(block_id, expected);
+            expected++;
+        };
+        ASSERT_THROW(parallel_decode(failing, threads, consume), std::runtime_error);
+        ASSERT_LE(expected, 100ULL);
+        if (threads == 1)
+            ASSERT_EQ(expected, 100ULL);
+        ASSERT_FALSE(failing.sequential);
+
+        // so does a failing consumer
+        slow_block_source src(300);
+        size_t consumed = 0;
+        ASSERT_THROW(parallel_decode(src, threads, [&](size_t block_id, const uint8_t*, size_t) {
+            consumed++;
+            if (block_id == 30)
+                throw std::logic_error("consumer failed");
+        }, 0, 300), std::logic_error);
+        ASSERT_EQ(consumed, 31ULL);
+    }
+}
+
+/* the blocks of the test collection, with one byte of one block changed */
+struct corrupt_block_source {
+    static const uint64_t block_size = 4096;
+    struct context_type {
+    };
+    std::vector<uint8_t> text;
+    size_t corrupt_block;
+
+    context_type create_context() const
+    {
+        return context_type();
+    }
+    void prefetch_blocks(const std::vector<uint64_t>&) const
+    {
+    }
+    uint64_t decode_block(context_type&, uint64_t block_id, std::vector<uint8_t>& out) const
+    {
+        auto beg = block_id * block_size;
+        auto len = std::min<uint64_t>(block_size, text.size() - beg);
+        std::copy(text.begin() + beg, text.begin() + beg + len, out.begin());
+        if (block_id == corrupt_block)
+            out[len / 2]++;
+        return len;
+    }
+};
+
+TEST(parallel_decode, verify_index)
+{
+    corrupt_block_source src{ test_text(), std::numeric_limits<size_t>::max() };
+    ASSERT_TRUE(verify_index(test_collection(), src, 4));
+    src.corrupt_block = 3;
+    ASSERT_FALSE(verify_index(test_collection(), src, 4));
+    ASSERT_FALSE(verify_index(test_collection(), src, 1));
+    src.corrupt_block = src.text.size() / corrupt_block_source::block_size;
+    ASSERT_FALSE(verify_index(test_collection(), src, 4));
+}
+
+/* random words stored as an sdsl bit vector whose size is not a multiple of 64 */
+void write_test_bits(const std::string& file_name, size_t num_bits)
+{
+    sdsl::bit_vector bv(num_bits);
+    std::mt19937_64 gen(4711);
+    for (size_t i = 0; i + 64 <= num_bits; i += 64)
+        bv.set_int(i, gen());
+    sdsl::store_to_file(bv, file_name);
+}
+
+TEST(block_file_reader, read_words)
+{
+    auto file_name = "unit_test_bits.sdsl";
+    write_test_bits(file_name, 1000000 - 5);
+    {
+        const sdsl::int_vector_mapper<1, std::ios_base::in> mapped(file_name);
+        const uint64_t* words = mapped.data();
+        const uint64_t size = mapped.size();
+        std::vector<std::pair<uint64_t, uint64_t> > ranges = { { 0, 1 }, { 0, 64 }, { 63, 65 }, { 4095 * 8, 4097 * 8 + 1 },
+            { size - 1, size }, { size - 100, size }, { 0, size } };
+        std::mt19937_64 gen(4711);
+        for (size_t i = 0; i < 200; i++) {
+            uint64_t beg = gen() % size;
+            ranges.push_back({ beg, beg + 1 + gen() % std::min<uint64_t>(size - beg, 100000) });
+        }
+        for (bool direct : { false, true }) {
+            std::unique_ptr<block_file_reader> reader(block_file_reader::open_sdsl(file_name, 1 << 20, direct));
+            ASSERT_EQ(reader->size(), size);
+            for (const auto& r : ranges) {
+                auto w = reader->read_words(r.first, r.second);
+                auto word_beg = r.first / 64;
+                auto word_end = (r.second + 63) / 64;
+                auto len = (word_end - word_beg) * 8;
+                ASSERT_EQ(w->size(), len + block_file_reader::padding_bytes);
+                ASSERT_EQ(memcmp(w->data(), words + word_beg, len), 0);
+                for (size_t k = len; k < w->size(); k++)
+                    ASSERT_EQ((*w)[k], 0);
+            }
+
+            // blocks read through read() are kept in the cache
+            auto a = reader->read(7, 1000, 5000);
+            auto b = reader->read(7, 1000, 5000);
+            ASSERT_EQ(a.get(), b.get());
+            ASSERT_EQ(memcmp(a->data(), words + 1000 / 64, ((5000 + 63) / 64 - 1000 / 64) * 8), 0);
+            auto stats = reader->cache_statistics();
+            ASSERT_EQ(stats.hits, 1ULL);
+            ASSERT_EQ(stats.misses, 1ULL);
+        }
+    }
+    std::remove(file_name);
+}
+
+TEST(io_ring, slot_reuse)
+{
+    auto file_name = "unit_test_ring.sdsl";
+    write_test_bits(file_name, 1 << 22);
+    {
+        const sdsl::int_vector_mapper<1, std::ios_base::in> mapped(file_name);
+        const uint8_t* bytes = (const uint8_t*)mapped.data();
+        int fd = open(file_name, O_RDONLY);
+        ASSERT_GE(fd, 0);
+        const size_t depth = 4, num_reads = 64, len = 1000;
+        io_ring ring(depth);
+        if (!ring.ok()) {
+            close(fd);
+            std::remove(file_name);
+            return; // io_uring not permitted here; read_blocks falls back to pread
+        }
+        std::vector<std::vector<uint8_t> > bufs(depth, std::vector<uint8_t>(len));
+        std::vector<uint64_t> offsets(depth);
+        std::mt19937_64 gen(4711);
+        size_t issued = 0, completed = 0;
+        auto issue = [&](size_t slot) {
+            offsets[slot] = gen() % ((1 << 22) / 8 - len);
+            // the sdsl size word comes before the data
+            return ring.read(fd, bufs[slot].data(), len, 8 + offsets[slot], slot);
+        };
+        for (size_t slot = 0; slot < depth; slot++, issued++)
+            ASSERT_TRUE(issue(slot));
+        ASSERT_FALSE(ring.read(fd, bufs[0].data(), len, 0, 0)); // full
+        ring.submit();
+        ASSERT_EQ(ring.inflight(), depth);
+        uint64_t slot;
+        int res;
+        while (ring.wait(slot, res)) {
+            ASSERT_LT(slot, depth);
+            ASSERT_EQ(res, (int)len);
+            ASSERT_EQ(memcmp(bufs[slot].data(), bytes + offsets[slot], len), 0);
+            completed++;
+            if (issued < num_reads) {
+                ASSERT_TRUE(issue(slot));
+                ring.submit();
+                issued++;
+            }
+        }
+        ASSERT_EQ(completed, num_reads);
+        ASSERT_EQ(ring.inflight(), 0U);
+        close(fd);
+    }
+    std::remove(file_name);
+}
+
+TEST(io_ring, unavailable)
+{
+    io_ring ring(0);
+    ASSERT_FALSE(ring.ok());
+    uint8_t buf[8];
+    uint64_t user_data;
+    int res;
+    ASSERT_FALSE(ring.read(0, buf, sizeof(buf), 0, 0));
+    ASSERT_FALSE(ring.wait(user_data, res));
+}
+
+/* reads the requests through read_blocks and checks each is handed over once with the words of the file */
+void check_read_blocks(const block_file_reader& reader, const std::vector<block_file_reader::block_request>& requests,
+    size_t queue_depth, const uint64_t* words, uint64_t file_words)
+{
+    std::vector<size_t> seen(requests.size());
+    reader.read_blocks(requests, queue_depth, [&](size_t i, const block_file_reader::value_type& w) {
+        seen[i]++;
+        auto word_beg = requests[i].bit_beg / 64;
+        auto word_end = (requests[i].bit_end + 63) / 64;
+        ASSERT_EQ(w->size(), (word_end - word_beg) * 8 + block_file_reader::padding_bytes);
+        for (auto k = word_beg; k < word_end; k++) {
+            // words past the end of the file read as zero
+            uint64_t expected = (k < file_words) ? words[k] : 0;
+            uint64_t got;
+            memcpy(&got, w->data() + (k - word_beg) * 8, 8);
+            ASSERT_EQ(got, expected);
+        }
+    });
+    for (auto n : seen)
+        ASSERT_EQ(n, 1ULL);
+}
+
+TEST(block_file_reader, read_blocks)
+{
+    auto file_name = "unit_test_blocks.sdsl";
+    write_test_bits(file_name, 1000000 - 5);
+    {
+        const sdsl::int_vector_mapper<1, std::ios_base::in> mapped(file_name);
+        const uint64_t size = mapped.size();
+        const uint64_t file_words = (size + 63) / 64;
+        std::mt19937_64 gen(4711);
+        std::vector<block_file_reader::block_request> requests;
+        for (uint64_t i = 0; i < 100; i++) {
+            uint64_t beg = gen() % size;
+            requests.push_back({ i, beg, beg + 1 + gen() % std::min<uint64_t>(size - beg, 50000) });
+        }
+        requests.push_back({ 100, size - 10, size });
+        for (bool direct : { false, true }) {
+            // queue depths smaller than the batch reuse the ring slots, 0 reads with pread
+            for (size_t queue_depth : { 0, 1, 3, 16, 256 }) {
+                std::unique_ptr<block_file_reader> reader(block_file_reader::open_sdsl(file_name, 1 << 24, direct));
+                // cached blocks are handed over first
+                for (uint64_t i = 0; i < 100; i += 10)
+                    reader->read(requests[i].block_id, requests[i].bit_beg, requests[i].bit_end);
+                check_read_blocks(*reader, requests, queue_depth, mapped.data(), file_words);
+                check_read_blocks(*reader, requests, queue_depth, mapped.data(), file_words);
+            }
+
+            // a failing consumer ends the batch once the reads in flight are reaped,
+            // and the reader stays usable
+            {
+                std::unique_ptr<block_file_reader> reader(block_file_reader::open_sdsl(file_name, 0, direct));
+                size_t calls = 0;
+                auto failing = [&](size_t, const block_file_reader::value_type&) {
+                    if (++calls == 5)
+                        throw std::runtime_error("consumer failed");
+                };
+                ASSERT_THROW(reader->read_blocks(requests, 16, failing), std::runtime_error);
+                ASSERT_EQ(calls, 5ULL);
+                check_read_blocks(*reader, requests, 16, mapped.data(), file_words);
+            }
+
+            // a stream claiming more bits than the file holds: reads at the end come back short
+            // and are finished with pread, the missing words are zero
+            std::unique_ptr<block_file_reader> truncated(new block_file_reader(file_name, 8, size + 64 * 10000, 0, direct));
+            std::vector<block_file_reader::block_request> past_end = {
+                { 0, size - 1000, size + 64 * 5000 }, { 1, 0, 1000 }, { 2, size + 64 * 100, size + 64 * 200 },
+                { 3, size - 64 * 1000, size + 64 * 10000 }
+            };
+            check_read_blocks(*truncated, past_end, 4, mapped.data(), file_words);
+
+            // more slots than an io_uring may have: the ring cannot be set up and all blocks are read with pread
+            std::unique_ptr<block_file_reader> reader(block_file_reader::open_sdsl(file_name, 0, direct));
+            std::vector<block_file_reader::block_request> many;
+            for (uint64_t i = 0; i < 40000; i++) {
+                uint64_t beg = gen() % size;
+                many.push_back({ i, beg, std::min(size, beg + 64) });
+            }
+            ASSERT_FALSE(io_ring(many.size()).ok());
+            check_read_blocks(*reader, many, many.size(), mapped.data(), file_words);
+        }
+    }
+    std::remove(file_name);
+}
+
+TEST(store_container, roundtrip)
+{
+    std::mt19937 gen(4711);
+    std::vector<uint8_t> a(10000), b(5000);
+    for (auto& x : a)
+        x = gen();
+    for (auto& x : b)
+        x = gen();
+    std::vector<uint64_t> words = { 1, 2, 3 };
+    auto file_name = "store_container_test.rlzc";
+    store_container::write(file_name, { { "a", a.data(), a.size() }, { "words", (const uint8_t*)words.data(), 24 },
+                                          { "empty", nullptr, 0 }, { "b", b.data(), b.size() } });
+    {
+        store_container c(file_name);
+        ASSERT_EQ(c.sections().size(), 4ULL);
+        ASSERT_EQ(c.size() % store_container::page_size, 0ULL);
+        for (const auto& sec : c.sections())
+            ASSERT_EQ((sec.data - c.sections()[0].data) % store_container::page_size, 0);
+        const auto& sa = c.get("a");
+        ASSERT_EQ(std::vector<uint8_t>(sa.data, sa.data + sa.size), a);
+        const auto& sb = c.get("b");
+        ASSERT_EQ(std::vector<uint8_t>(sb.data, sb.data + sb.size), b);
+        ASSERT_EQ(((const uint64_t*)c.get("words").data)[2], 3ULL);
+        ASSERT_EQ(c.get("empty").size, 0ULL);
+        ASSERT_FALSE(c.has("c"));
+        ASSERT_THROW(c.get("c"), std::runtime_error);
+    }
+    std::remove(file_name);
+}
+
+
+TEST(store_container, build_export_open)
+{
+    using store_type = test_store<test_coder>;
+    auto text = test_text();
+    auto file_name = "unit_test_store.rlzc";
+    std::remove(file_name);
+    auto store = store_type::builder{}
+                     .set_dict_size(8 * 1024)
+                     .set_skip_index(true)
+                     .set_container(file_name)
+                     .build_or_load(test_collection());
+    {
+        store_type deployed(file_name);
+        ASSERT_EQ(deployed.size(), text.size());
+        ASSERT_EQ(deployed.block_map.num_blocks(), store.block_map.num_blocks());
+        ASSERT_TRUE(deployed.has_skip_index());
+        auto ctx = deployed.create_context();
+        auto store_ctx = store.create_context();
+        for (size_t block_id = 0; block_id < deployed.block_map.num_blocks(); block_id++) {
+            auto block = deployed.block(ctx, block_id);
+            ASSERT_EQ(block, store.block(store_ctx, block_id));
+            ASSERT_TRUE(std::equal(block.begin(), block.end(), text.begin() + block_id * store_type::block_size));
+        }
+        std::vector<uint8_t> range(1000);
+        ASSERT_EQ(deployed.extract(ctx, 12345, range.size(), range.data()), range.size());
+        ASSERT_TRUE(std::equal(range.begin(), range.end(), text.begin() + 12345));
+        auto range_doc = deployed.documents().doc_range(7);
+        auto doc = deployed.get_document("D7", 1);
+        ASSERT_TRUE(std::equal(doc.begin(), doc.end(), text.begin() + range_doc.first));
+    }
+    std::remove(file_name);
+}
 
 int main(int argc, char* argv[])
 {